@@ -0,0 +1,103 @@
+/**
+ * Microbenchmark of a timer's Start()/Stop() pair.
+ *
+ * Compares the inlined Start()/Stop() against the out-of-line
+ * _Start()/_Stop() (which is what every TIMER_START()/TIMER_STOP()
+ * used to call), for the default clock and the TSC.
+ *
+ * Build and run (after building the library):
+ *   g++ -O2 -Isrc benchmark/Start_Stop.cpp -Llib -ltiming -lrt -lpthread -o start_stop
+ *   ./start_stop [nb_pairs]
+ */
+
+#include <Timing.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+const uint64_t default_nb_pairs = 10000000;
+
+// **************************************************************
+template <class ClockSource>
+double Nanoseconds_per_Clock_Pair(const uint64_t nb_pairs)
+/**
+ * Reading the clock twice: the lower bound of any timer.
+ */
+{
+    uint64_t sum = 0;
+    const uint64_t start = timing::Clock_Monotonic::Get_Ticks();
+    for (uint64_t i = 0 ; i < nb_pairs ; i++)
+    {
+        const uint64_t t0 = ClockSource::Get_Ticks();
+        sum += ClockSource::Get_Ticks() - t0;
+    }
+    const uint64_t end = timing::Clock_Monotonic::Get_Ticks();
+    // Prevent the loop from being optimized away.
+    if (sum == 1)
+        printf(" ");
+    return double(end - start) / double(nb_pairs);
+}
+
+// **************************************************************
+template <class ClockSource>
+double Nanoseconds_per_Inline_Pair(timing::Basic_Timer<ClockSource> &timer, const uint64_t nb_pairs)
+{
+    const uint64_t start = timing::Clock_Monotonic::Get_Ticks();
+    for (uint64_t i = 0 ; i < nb_pairs ; i++)
+    {
+        timer.Start();
+        timer.Stop();
+    }
+    const uint64_t end = timing::Clock_Monotonic::Get_Ticks();
+    return double(end - start) / double(nb_pairs);
+}
+
+// **************************************************************
+template <class ClockSource>
+double Nanoseconds_per_Out_Of_Line_Pair(timing::Basic_Timer<ClockSource> &timer, const uint64_t nb_pairs)
+{
+    const uint64_t start = timing::Clock_Monotonic::Get_Ticks();
+    for (uint64_t i = 0 ; i < nb_pairs ; i++)
+    {
+        timer._Start();
+        timer._Stop();
+    }
+    const uint64_t end = timing::Clock_Monotonic::Get_Ticks();
+    return double(end - start) / double(nb_pairs);
+}
+
+// **************************************************************
+template <class ClockSource>
+void Benchmark(const char *clock_name, const uint64_t nb_pairs)
+{
+    timing::Basic_Timer<ClockSource> &inline_timer      = timing::New_Timer<ClockSource>("inline",      "inline");
+    timing::Basic_Timer<ClockSource> &out_of_line_timer = timing::New_Timer<ClockSource>("out of line", "out_of_line");
+
+    // Warm up (TSC calibration, caches, frequency scaling)
+    Nanoseconds_per_Inline_Pair(inline_timer, nb_pairs/10);
+
+    const double clock_pair  = Nanoseconds_per_Clock_Pair<ClockSource>(nb_pairs);
+    const double inlined     = Nanoseconds_per_Inline_Pair(inline_timer, nb_pairs);
+    const double out_of_line = Nanoseconds_per_Out_Of_Line_Pair(out_of_line_timer, nb_pairs);
+
+    printf("| %-16s | %10.2f | %10.2f | %11.2f |\n", clock_name, clock_pair, inlined, out_of_line);
+}
+
+// **************************************************************
+int main(int argc, char *argv[])
+{
+    const uint64_t nb_pairs = (argc > 1 ? uint64_t(atol(argv[1])) : default_nb_pairs);
+
+    printf("Nanoseconds per Start()/Stop() pair (%lu pairs)\n", (unsigned long) nb_pairs);
+    printf("|------------------|------------|------------|-------------|\n");
+    printf("| Clock source     | Two clock  |  Inlined   | Out-of-line |\n");
+    printf("|                  |   reads    |            |             |\n");
+    printf("|------------------|------------|------------|-------------|\n");
+    Benchmark<timing::Clock_Monotonic>("monotonic", nb_pairs);
+    Benchmark<timing::Clock_TSC>("tsc", nb_pairs);
+    printf("|------------------|------------|------------|-------------|\n");
+
+    return EXIT_SUCCESS;
+}
+
+// ********** End of file ***************************************
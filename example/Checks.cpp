@@ -0,0 +1,407 @@
+/**
+ * Checks of the library's features, run by example/Main.cpp before
+ * its demonstration (alone with "--checks").
+ *
+ * Each check prints "ok" or "FAILED" followed by what it verifies.
+ * Main.cpp enables the features the checks' timers need before
+ * calling Run_Checks().
+ */
+
+#include <stdint.h> // uint64_t
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+
+#include "Timing.hpp"
+
+namespace
+{
+    int nb_failures = 0;
+
+    const int      nb_threads        = 4;
+    const uint64_t calls_per_thread  = 1000;
+    // Keeps the threads alive together: an exited thread's index (and shard) is reused
+    pthread_barrier_t threads_barrier;
+
+    // **************************************************************
+    void Check(const bool condition, const std::string &what)
+    {
+        std::cout << (condition ? "  ok:     " : "  FAILED: ") << what << "\n";
+        if (not condition)
+            nb_failures++;
+    }
+
+    // **************************************************************
+    bool Near(const double value, const double expected, const double relative, const double absolute = 0.0)
+    {
+        return std::fabs(value - expected) <= relative * std::fabs(expected) + absolute;
+    }
+
+    // **************************************************************
+    void Spin(const double seconds)
+    /**
+     * Busy wait: steadier than timing::Wait() for short durations.
+     */
+    {
+        const uint64_t end = timing::Clock_Monotonic::Get_Ticks() + uint64_t(seconds * timing::sec_to_nanosec);
+        while (timing::Clock_Monotonic::Get_Ticks() < end)
+            ;
+    }
+
+    // **************************************************************
+    timing::Timer_Base & Timer_Named(const std::string &name)
+    /**
+     * The timer must exist (created by a TIMER_START() above).
+     */
+    {
+        const timing::Timer_Id id = timing::Find_Timer(name);
+        if (id == timing::invalid_timer_id)
+        {
+            std::cout << "Timer \"" << name << "\" does not exist!\n";
+            abort();
+        }
+        return timing::Get_Timer(id);
+    }
+
+    // **************************************************************
+    void * Shards_Thread(void *)
+    {
+        pthread_barrier_wait(&threads_barrier);
+        for (uint64_t i = 0 ; i < calls_per_thread ; i++)
+        {
+            TIMER_START("check shards", Check_Shards);
+            TIMER_STOP("check shards", Check_Shards);
+        }
+        pthread_barrier_wait(&threads_barrier);
+        return NULL;
+    }
+
+    // **************************************************************
+    void Check_Shard_Merging()
+    {
+        std::cout << "Shard merging (threaded mode)\n";
+
+        pthread_t threads[nb_threads];
+        pthread_barrier_init(&threads_barrier, NULL, nb_threads);
+        for (int i = 0 ; i < nb_threads ; i++)
+            pthread_create(&threads[i], NULL, Shards_Thread, NULL);
+        for (int i = 0 ; i < nb_threads ; i++)
+            pthread_join(threads[i], NULL);
+        pthread_barrier_destroy(&threads_barrier);
+
+        timing::Timer_Base &timer = Timer_Named("check shards");
+        timer.Merge_Shards();
+
+        double min, max, mean;
+        const int nb_shards = timer.Thread_Statistics(min, max, mean);
+        Check(nb_shards == nb_threads, "one shard per thread");
+        Check(timer.Get_Counter() == nb_threads * calls_per_thread, "merged calls are the sum of the shards' calls");
+        Check(Near(timer.Get_Duration(), double(nb_threads) * mean, 1.0e-9, 1.0e-12),
+              "merged duration is the sum of the shards' durations");
+    }
+
+    // **************************************************************
+    void Check_Call_Path(const std::string &folder)
+    {
+        std::cout << "Call-path totals\n";
+
+        TIMER_START("check outer", Check_Outer);
+        timing::Wait(0.02);
+        TIMER_START("check inner", Check_Inner);
+        timing::Wait(0.01);
+        TIMER_STOP("check inner", Check_Inner);
+        TIMER_STOP("check outer", Check_Outer);
+
+        // Only one call in four of a sampled timer enters the call path
+        TIMER_START("check sampled parent", Check_Sampled_Parent);
+        for (int i = 0 ; i < 200 ; i++)
+        {
+            TIMER_START_SAMPLED("check sampled node", Check_Sampled_Node, 4, false);
+            Spin(5.0e-5);
+            TIMER_STOP("check sampled node", Check_Sampled_Node);
+        }
+        TIMER_STOP("check sampled parent", Check_Sampled_Parent);
+        // Extrapolating the node needs the timer's calls from every thread
+        timing::Timer_Base &sampled = Timer_Named("check sampled node");
+        sampled.Merge_Shards();
+
+        const std::string filename = folder + "/check_call_path.folded";
+        timing::Export_Folded_Stacks(filename);
+
+        // "Thread n;check outer[;check inner] microseconds" lines
+        double outer_exclusive = -1.0, inner_exclusive = -1.0, sampled_exclusive = -1.0;
+        std::ifstream file(filename.c_str());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t space = line.rfind(' ');
+            const std::string stack = line.substr(0, space);
+            const double seconds = std::atof(line.c_str() + space + 1) * 1.0e-6;
+            if (stack.find(";check sampled parent;check sampled node") != std::string::npos)
+                sampled_exclusive = seconds;
+            else if (stack.find(";check outer;check inner") != std::string::npos)
+                inner_exclusive = seconds;
+            else if (stack.find(";check outer") != std::string::npos)
+                outer_exclusive = seconds;
+        }
+
+        timing::Timer_Base &outer = Timer_Named("check outer");
+        timing::Timer_Base &inner = Timer_Named("check inner");
+        outer.Merge_Shards();
+        inner.Merge_Shards();
+        Check(outer_exclusive > 0.0 and inner_exclusive > 0.0, "both nodes are in " + filename);
+        Check(Near(inner_exclusive, inner.Get_Duration(), 0.0, 2.0e-6), "inner node's time is the inner timer's duration");
+        Check(Near(outer_exclusive + inner_exclusive, outer.Get_Duration(), 0.0, 4.0e-6),
+              "outer node's inclusive time (exclusive + child) is the outer timer's duration");
+        Check(outer_exclusive >= 0.02 and inner_exclusive >= 0.01, "each node's exclusive time covers its own wait");
+
+        Check(Near(sampled_exclusive, sampled.Get_Estimated_Duration(), 0.0, 2.0e-6),
+              "sampled node's time is extrapolated like the sampled timer's duration");
+    }
+
+    // **************************************************************
+    void Check_Histogram_Percentiles()
+    {
+        std::cout << "Histogram percentiles\n";
+
+        // Values 1 to 10000, split in two histograms then merged
+        timing::Histogram all(5), odd(5), even(5);
+        for (uint64_t value = 1 ; value <= 10000 ; value++)
+        {
+            all.Record(value);
+            if (value % 2 == 1)
+                odd.Record(value);
+            else
+                even.Record(value);
+        }
+        odd.Merge(even);
+
+        // 5 bits of precision: within 1/16 of the value
+        Check(Near(double(all.Percentile(50.0)), 5000.0, 1.0/16.0), "p50 is within the precision");
+        Check(Near(double(all.Percentile(99.0)), 9900.0, 1.0/16.0), "p99 is within the precision");
+        Check(all.Percentile(100.0) == 10000, "p100 is the largest value");
+        Check(odd.count == all.count and odd.Percentile(50.0) == all.Percentile(50.0)
+              and odd.Percentile(99.9) == all.Percentile(99.9), "merged histograms give the same percentiles");
+
+        const timing::Timer_Base &timer = Timer_Named("check shards");
+        const double p50 = timer.Get_Percentile(50.0);
+        Check(p50 > 0.0 and p50 <= timer.Get_Max(), "threaded timer's merged histogram has a median");
+    }
+
+    // **************************************************************
+    void Check_Statistics_Merge()
+    {
+        std::cout << "Welford/Chan statistics merge\n";
+
+        // Two very different halves, so a naive merge of the variances would be wrong
+        timing::DurationStatistics all, first, second;
+        double sum = 0.0;
+        const int nb_first = 1000, nb_second = 300;
+        for (int i = 0 ; i < nb_first + nb_second ; i++)
+        {
+            const uint64_t ticks = (i < nb_first ? uint64_t(1000 + (i * 37) % 1000) : uint64_t(100000 + (i * 7) % 500));
+            all.Record(ticks);
+            (i < nb_first ? first : second).Record(ticks);
+            sum += double(ticks);
+        }
+        const double mean = sum / double(nb_first + nb_second);
+        double squares = 0.0;
+        for (int i = 0 ; i < nb_first + nb_second ; i++)
+        {
+            const double ticks = double(i < nb_first ? 1000 + (i * 37) % 1000 : 100000 + (i * 7) % 500);
+            squares += (ticks - mean) * (ticks - mean);
+        }
+        const double variance = squares / double(nb_first + nb_second - 1);
+
+        first.Merge(second);
+        Check(first.count == all.count and first.min == all.min and first.max == all.max, "merged count and extremes");
+        Check(Near(first.mean, mean, 1.0e-12), "merged mean is the two-pass mean");
+        Check(Near(first.Variance(), variance, 1.0e-9), "merged variance is the two-pass variance");
+        Check(Near(first.Variance(), all.Variance(), 1.0e-9), "merged variance is the single pass' variance");
+    }
+
+    // **************************************************************
+    void Check_Sampled_Extrapolation()
+    {
+        std::cout << "Sampled extrapolation\n";
+
+        const int nb_calls = 200;
+        const uint32_t period = 4;
+        for (int i = 0 ; i < nb_calls ; i++)
+        {
+            TIMER_START_SAMPLED("check sampled", Check_Sampled, period, false);
+            Spin(0.0002);
+            TIMER_STOP("check sampled", Check_Sampled);
+        }
+        for (int i = 0 ; i < nb_calls ; i++)
+        {
+            TIMER_START("check not sampled", Check_Not_Sampled);
+            Spin(0.0002);
+            TIMER_STOP("check not sampled", Check_Not_Sampled);
+        }
+
+        timing::Timer_Base &sampled   = Timer_Named("check sampled");
+        timing::Timer_Base &reference = Timer_Named("check not sampled");
+        sampled.Merge_Shards();
+        reference.Merge_Shards();
+        Check(sampled.Is_Sampled() and sampled.Get_Counter() == uint64_t(nb_calls), "every call is counted");
+        Check(Near(sampled.Get_Estimated_Duration(), double(period) * sampled.Get_Duration(), 1.0e-9),
+              "estimate scales the timed calls by the period");
+        Check(sampled.Get_Estimated_Duration_Error() > 0.0, "estimate has a confidence interval");
+        // The reference's median (within the histogram's 1/16) ignores its preempted calls;
+        // a preempted timed call widens the interval as much as it moves the estimate.
+        Check(Near(sampled.Get_Estimated_Duration(), double(nb_calls) * reference.Get_Percentile(50.0), 0.15,
+                   2.0 * sampled.Get_Estimated_Duration_Error()),
+              "estimate is close to the same calls timed every time");
+    }
+
+    // **************************************************************
+    void Check_Interval_Report(const std::string &folder)
+    {
+        std::cout << "Interval report deltas\n";
+
+        const std::string filename = folder + "/check_intervals.csv";
+        timing::Enable_Interval_Report(filename, 10);
+        for (uint64_t step = 0 ; step < 30 ; step++)
+        {
+            TIMERS_SET_STEP(step);
+            TIMER_START("check interval", Check_Interval);
+            timing::Wait(0.001);
+            TIMER_STOP("check interval", Check_Interval);
+        }
+        timing::Close_Interval_Report();
+
+        // "Step begin, Step end, Time begin (s), Interval (s), "Timer", Calls, Time (s), % of interval"
+        int nb_rows = 0, nb_good_rows = 0;
+        std::ifstream file(filename.c_str());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() or line[0] == '#' or line.find("\"check interval\"") == std::string::npos)
+                continue;
+            uint64_t begin = 0, end = 0, calls = 0;
+            double seconds = 0.0;
+            const size_t name_end = line.rfind('"');
+            std::sscanf(line.c_str(), "%" SCNu64 ", %" SCNu64, &begin, &end);
+            std::sscanf(line.c_str() + name_end + 1, ", %" SCNu64 ", %lf", &calls, &seconds);
+            nb_rows++;
+            if (begin == uint64_t(10 * (nb_rows - 1)) and calls == 10 and seconds >= 0.01)
+                nb_good_rows++;
+        }
+        Check(nb_rows == 3, "one row per interval of 10 steps");
+        Check(nb_good_rows == nb_rows, "each row holds its interval's 10 calls and their time");
+    }
+
+    // **************************************************************
+    void Check_Eta_Band()
+    {
+        std::cout << "ETA confidence band\n";
+
+        // 10 of 40 steps of 5 ms each
+        const double step_seconds = 0.005;
+        timing::Eta_Estimator eta(0.0, 40.0, timing::ETA_AVERAGE);
+        for (int step = 0 ; step <= 10 ; step++)
+        {
+            if (step != 0)
+                timing::Wait(step_seconds);
+            eta.Update(double(step));
+        }
+
+        double remaining = 0.0, low = 0.0, high = 0.0;
+        const bool has_estimate = eta.Estimate(remaining, low, high);
+        char text[64];
+        eta.Format(text, sizeof(text));
+        Check(has_estimate, std::string("estimate is available: ") + text);
+        Check(low <= remaining and remaining <= high, "band contains the estimate");
+        Check(Near(remaining, 30.0 * step_seconds, 0.5), "estimate is close to the remaining steps' time");
+    }
+
+    // **************************************************************
+    struct Stalls
+    {
+        int nb;
+        uint64_t last_t;
+    };
+
+    // **************************************************************
+    void Count_Stall(const uint64_t t, const double seconds, const double median, void *data)
+    {
+        Stalls *stalls = static_cast<Stalls *>(data);
+        stalls->nb++;
+        stalls->last_t = t;
+    }
+
+    // **************************************************************
+    void Check_Stall_Callback()
+    {
+        std::cout << "Stall callback\n";
+
+        const uint64_t slow_t = 15;
+        Stalls stalls;
+        stalls.nb     = 0;
+        stalls.last_t = 0;
+        timing::TimestepTiming timestep_timing;
+        timestep_timing.Set_Stall_Callback(Count_Stall, 5.0, &stalls);
+        for (uint64_t t = 0 ; t <= 20 ; t++)
+        {
+            timing::Wait(t == slow_t ? 0.05 : 0.003);
+            timestep_timing.Set_Timestep(t);
+            if (t == slow_t)
+                Check(stalls.nb >= 1 and stalls.last_t == slow_t, "slow timestep calls the callback");
+        }
+        Check(timestep_timing.Nb_Stalls() == uint64_t(stalls.nb), "stalls are counted");
+    }
+
+    // **************************************************************
+    void Check_Export()
+    {
+        std::cout << "JSON/CSV export\n";
+
+        std::ostringstream json;
+        timing::Write_Summary_JSON(json, 1);
+        Check(json.str().find("\"name\": \"check shards\", \"calls\": 4000, \"timed_calls\": 4000") != std::string::npos,
+              "JSON holds the threaded timer's merged calls");
+        Check(json.str().find("\"name\": \"check sampled\", \"calls\": 200, \"timed_calls\": 50, \"sampling_period\": 4")
+              != std::string::npos, "JSON holds the sampled timer's calls and timed calls");
+
+        std::ostringstream csv;
+        timing::Write_Summary_CSV(csv, 1);
+        Check(csv.str().find("\n\"check shards\", 4000, 4000, 0, ") != std::string::npos,
+              "CSV holds the threaded timer's merged calls");
+        Check(csv.str().find("\n\"check sampled\", 200, 50, 4, ") != std::string::npos,
+              "CSV holds the sampled timer's calls and timed calls");
+    }
+} // namespace
+
+// **************************************************************
+int Run_Checks(const std::string &folder)
+/**
+ * Run every check, saving their files in "folder". Return the
+ * number of failed checks.
+ */
+{
+    nb_failures = 0;
+
+    Check_Shard_Merging();
+    Check_Call_Path(folder);
+    Check_Histogram_Percentiles();
+    Check_Statistics_Merge();
+    Check_Sampled_Extrapolation();
+    Check_Interval_Report(folder);
+    Check_Eta_Band();
+    Check_Stall_Callback();
+    Check_Export();
+
+    if (nb_failures == 0)
+        std::cout << "All checks passed.\n\n";
+    else
+        std::cout << nb_failures << " check(s) FAILED!\n\n";
+    return nb_failures;
+}
+
+// ********** End of file ***************************************
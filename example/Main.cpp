@@ -7,10 +7,13 @@
 #include <limits>  // http://www.cplusplus.com/reference/std/limits/numeric_limits/
 #include <iostream>
 #include <cstdlib>
+#include <string>
 
 // #define DISABLE_TIMING
 #include "Timing.hpp"
 
+// See Checks.cpp
+int Run_Checks(const std::string &folder);
 
 // **************************************************************
 int main(int argc, char *argv[])
@@ -21,6 +24,19 @@ int main(int argc, char *argv[])
     // Enable saving the timing information in "output" folder.
     TIMERS_ENABLE_OUTPUT("output");
 
+    // Features used by Checks.cpp; like the output, they must be enabled
+    // before any TIMER_START().
+    TIMERS_ENABLE_THREADED();
+    TIMERS_ENABLE_CALL_PATH();
+    TIMERS_ENABLE_HISTOGRAMS(5);
+
+    // Check the library's features first ("--checks" to stop there).
+    const int nb_failures = Run_Checks("output");
+    if (nb_failures != 0)
+        return EXIT_FAILURE;
+    if (argc > 1 and std::string(argv[1]) == "--checks")
+        return EXIT_SUCCESS;
+
     // Do heavy calculation here
     const int max_t = 10000000;
 
@@ -36,6 +52,7 @@ int main(int argc, char *argv[])
         TIMERS_SET_STEP(t);
 
         const double tmp = std::cos(t);
+        (void) tmp;
 
         // Print only 10 ETA, else we are flooded...
         if (t % (max_t/10) == 0)
@@ -50,6 +67,7 @@ int main(int argc, char *argv[])
         TIMERS_SET_STEP(max_t + t);
 
         const double tmp = std::sin(t);
+        (void) tmp;
 
         // Print only 10 ETA, else we are flooded...
         if (t % (max_t/10) == 0)
@@ -65,6 +83,7 @@ int main(int argc, char *argv[])
         TIMERS_SET_STEP(max_t + max_t + t);
 
         const double tmp = std::cos(t);
+        (void) tmp;
 
         // Print only 10 ETA, else we are flooded...
         if (t % (max_t/10) == 0)
@@ -0,0 +1,451 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>  // memcpy()
+#include <cstdio>   // rename(), remove()
+#include <unistd.h> // access()
+
+namespace timing
+{
+    extern Timer TimerTotal;
+    void Create_Folder_If_Does_Not_Exists(const std::string path);
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Transport used by timing::Print() (NULL: every rank prints alone)
+    Aggregation_Transport *aggregation_transport = NULL;
+    // Serialized timers of every rank, on rank 0 after Gather_Aggregation()
+    std::vector<std::string> aggregated_ranks;
+
+    // Environment variables giving a process' rank and the number of
+    // ranks, for the common launchers.
+    const char * const rank_variables[]     = {"TIMING_RANK",     "OMPI_COMM_WORLD_RANK", "PMI_RANK", "SLURM_PROCID", NULL};
+    const char * const nb_ranks_variables[] = {"TIMING_NB_RANKS", "OMPI_COMM_WORLD_SIZE", "PMI_SIZE", "SLURM_NTASKS", NULL};
+
+    // **********************************************************
+    struct Rank_Timer
+    /**
+     * What a rank sends for each of its timers (durations in seconds).
+     */
+    {
+        uint64_t counter;
+        uint64_t nb_timed;
+        double   duration;
+        double   mean;
+    };
+
+    // **********************************************************
+    template <class T>
+    void Append(std::string &buffer, const T &value)
+    {
+        buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    // **********************************************************
+    template <class T>
+    bool Extract(const std::string &buffer, size_t &position, T &value)
+    {
+        if (position + sizeof(T) > buffer.size())
+            return false;
+        memcpy(&value, buffer.data() + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    // **********************************************************
+    std::string Serialize_Timers()
+    /**
+     * Total duration, then the name and Rank_Timer of every timer.
+     */
+    {
+        std::string buffer;
+        Append(buffer, TimerTotal.Get_Duration());
+        Append(buffer, Nb_Timers());
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            Rank_Timer values;
+            values.counter  = timer.Get_Counter();
+            values.nb_timed = timer.Get_Statistics().count;
+            values.duration = timer.Get_Estimated_Duration();
+            values.mean     = timer.Get_Mean();
+            Append(buffer, uint32_t(timer.Get_Name().length()));
+            buffer.append(timer.Get_Name());
+            Append(buffer, values);
+        }
+        return buffer;
+    }
+
+    // **********************************************************
+    class Aggregated_Timer
+    /**
+     * A timer's values across the ranks having it.
+     */
+    {
+        public:
+            std::string name;
+            int      nb_ranks;
+            double   min;
+            double   max;
+            double   sum;
+            int      slowest_rank;
+            uint64_t counter;
+            uint64_t nb_timed;
+            double   mean_sum;      // Sum of the ranks' mean * nb_timed
+
+            Aggregated_Timer(const std::string &_name)
+            {
+                name         = _name;
+                nb_ranks     = 0;
+                min          = 0.0;
+                max          = 0.0;
+                sum          = 0.0;
+                slowest_rank = -1;
+                counter      = 0;
+                nb_timed     = 0;
+                mean_sum     = 0.0;
+            }
+
+            void Add(const int rank, const double duration, const uint64_t _counter, const uint64_t _nb_timed, const double mean)
+            {
+                if (nb_ranks == 0 or duration < min)
+                    min = duration;
+                if (nb_ranks == 0 or duration > max)
+                {
+                    max = duration;
+                    slowest_rank = rank;
+                }
+                sum      += duration;
+                counter  += _counter;
+                nb_timed += _nb_timed;
+                mean_sum += mean * double(_nb_timed);
+                nb_ranks++;
+            }
+
+            double Average() const
+            {
+                return (nb_ranks == 0 ? 0.0 : sum / double(nb_ranks));
+            }
+
+            double Imbalance() const
+            /**
+             * Slowest rank over the average: 1 when perfectly balanced.
+             */
+            {
+                return (Average() > 0.0 ? max / Average() : 1.0);
+            }
+    };
+
+    // **********************************************************
+    void Enable_Aggregation(Aggregation_Transport *transport)
+    /**
+     * Make timing::Print() gather every rank's timers through
+     * "transport" (which must outlive the call to timing::Print()).
+     * Only rank 0 then prints, adding the table of each timer across
+     * ranks. Every rank must call timing::Print().
+     */
+    {
+        aggregation_transport = transport;
+    }
+
+    // **********************************************************
+    bool Aggregation_Enabled()
+    {
+        return aggregation_transport != NULL;
+    }
+
+    // **********************************************************
+    bool Gather_Aggregation()
+    /**
+     * Send this rank's timers to rank 0. Return true if this rank
+     * prints the report.
+     */
+    {
+        if (aggregation_transport == NULL)
+            return true;
+
+        aggregated_ranks.clear();
+        aggregation_transport->Gather(Serialize_Timers(), aggregated_ranks);
+        return (aggregation_transport->Rank() == 0);
+    }
+
+    // **********************************************************
+    void Print_Aggregation(const char *s, const size_t _longest_length)
+    /**
+     * Print each timer's duration across ranks (on rank 0).
+     */
+    {
+        if (aggregation_transport == NULL or aggregated_ranks.empty())
+            return;
+
+        // Timers in the order ranks (rank 0 first) created them
+        std::vector<Aggregated_Timer> timers;
+        std::map<std::string, size_t> indices;
+        Aggregated_Timer total("Total");
+        int nb_reporting = 0;
+        for (size_t rank = 0 ; rank < aggregated_ranks.size() ; rank++)
+        {
+            const std::string &buffer = aggregated_ranks[rank];
+            if (buffer.empty())
+                continue;
+
+            size_t position = 0;
+            double total_duration = 0.0;
+            uint32_t nb_timers = 0;
+            if (not Extract(buffer, position, total_duration) or not Extract(buffer, position, nb_timers))
+            {
+                Report("WARNING: Invalid timers received from rank %d.\n", int(rank));
+                continue;
+            }
+            nb_reporting++;
+            total.Add(int(rank), total_duration, 1, 1, total_duration);
+
+            for (uint32_t i = 0 ; i < nb_timers ; i++)
+            {
+                uint32_t name_length = 0;
+                Rank_Timer values;
+                if (not Extract(buffer, position, name_length) or position + name_length > buffer.size())
+                    break;
+                const std::string name(buffer, position, name_length);
+                position += name_length;
+                if (not Extract(buffer, position, values))
+                    break;
+
+                std::map<std::string, size_t>::iterator it = indices.find(name);
+                if (it == indices.end())
+                {
+                    it = indices.insert(std::make_pair(name, timers.size())).first;
+                    timers.push_back(Aggregated_Timer(name));
+                }
+                timers[it->second].Add(int(rank), values.duration, values.counter, values.nb_timed, values.mean);
+            }
+        }
+
+        size_t longest_length = _longest_length;
+        for (size_t i = 0 ; i < timers.size() ; i++)
+        {
+            longest_length = std::max(longest_length, timers[i].name.length());
+        }
+
+        Report("%sTimers of %d rank(s) out of %d\n", s, nb_reporting, aggregation_transport->Nb_Ranks());
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  Ranks   |     Duration across ranks (seconds)    | Slowest  | Imbalance  |    Total     |  Mean per  |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|          |    min     |    avg     |    max     |   rank   |  max/avg   |    calls     |    call    |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|----------|------------|------------|------------|----------|------------|--------------|------------|\n");
+
+        for (size_t i = 0 ; i <= timers.size() ; i++)
+        {
+            const bool is_total = (i == timers.size());
+            const Aggregated_Timer &timer = (is_total ? total : timers[i]);
+            if (is_total)
+            {
+                Report("%s|", s);
+                Print_N_Times("-", longest_length+2, false);
+                Report("|----------|------------|------------|------------|----------|------------|--------------|------------|\n");
+            }
+
+            Report("%s| ", s);
+            Report_Padded(timer.name.c_str(), longest_length);
+            Report(" | %8d | %10.5g | %10.5g | %10.5g | %8d | %10.3f |", timer.nb_ranks,
+                                                                timer.min,
+                                                                timer.Average(),
+                                                                timer.max,
+                                                                timer.slowest_rank,
+                                                                timer.Imbalance());
+            if (is_total)
+                Report("              |            |\n");
+            else
+                Report(" %12" PRIu64 " | %10.4g |\n", (uint64_t) timer.counter,
+                                                      (timer.nb_timed == 0 ? 0.0 : timer.mean_sum / double(timer.nb_timed)));
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|----------|------------|------------|------------|----------|------------|--------------|------------|\n\n");
+    }
+
+    // **********************************************************
+    int Rank_From_Environment(const char * const variables[], const int default_value)
+    {
+        for (int i = 0 ; variables[i] != NULL ; i++)
+        {
+            const char *value = getenv(variables[i]);
+            if (value != NULL)
+                return atoi(value);
+        }
+        return default_value;
+    }
+
+    // **********************************************************
+    File_Transport::File_Transport(const std::string &_folder, const int _rank, const int _nb_ranks,
+                                   const double _timeout)
+    /**
+     * A negative "_rank" or "_nb_ranks" is read from the environment
+     * (TIMING_RANK and TIMING_NB_RANKS, or the variables set by Open MPI,
+     * MPICH and Slurm). The folder should be emptied between runs.
+     */
+    {
+        folder   = _folder;
+        rank     = (_rank     < 0 ? Rank_From_Environment(rank_variables,     0) : _rank);
+        nb_ranks = (_nb_ranks < 0 ? Rank_From_Environment(nb_ranks_variables, 1) : _nb_ranks);
+        timeout  = _timeout;
+        Create_Folder_If_Does_Not_Exists(folder);
+    }
+
+    // **********************************************************
+    int File_Transport::Rank() const
+    {
+        return rank;
+    }
+
+    // **********************************************************
+    int File_Transport::Nb_Ranks() const
+    {
+        return nb_ranks;
+    }
+
+    // **********************************************************
+    std::string Rank_Filename(const std::string &folder, const int rank)
+    {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "/timing_rank_%06d.bin", rank);
+        return folder + filename;
+    }
+
+    // **********************************************************
+    void File_Transport::Gather(const std::string &local, std::vector<std::string> &all)
+    /**
+     * Each file is written under a temporary name then renamed, so
+     * rank 0 never reads a partial file. Rank 0 deletes the files it read.
+     */
+    {
+        if (rank != 0)
+        {
+            const std::string filename = Rank_Filename(folder, rank);
+            const std::string temporary = filename + ".tmp";
+            {
+                std::ofstream file(temporary.c_str(), std::ios_base::out | std::ios_base::binary);
+                if (not file.is_open())
+                {
+                    log("ERROR: Could not open file \"%s\"!\n", temporary.c_str());
+                    return;
+                }
+                file.write(local.data(), std::streamsize(local.size()));
+            }
+            if (rename(temporary.c_str(), filename.c_str()) != 0)
+                log("ERROR: Could not rename \"%s\"!\n", temporary.c_str());
+            return;
+        }
+
+        all.assign(size_t(nb_ranks), std::string());
+        all[0] = local;
+
+        int nb_missing = nb_ranks - 1;
+        const uint64_t deadline_ns = Clock_Monotonic::Get_Ticks() + uint64_t(timeout * sec_to_nanosec);
+        while (nb_missing > 0)
+        {
+            for (int other = 1 ; other < nb_ranks ; other++)
+            {
+                if (not all[size_t(other)].empty())
+                    continue;
+                const std::string filename = Rank_Filename(folder, other);
+                if (access(filename.c_str(), R_OK) != 0)
+                    continue;
+
+                std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+                std::ostringstream content;
+                content << file.rdbuf();
+                all[size_t(other)] = content.str();
+                file.close();
+                remove(filename.c_str());
+                nb_missing--;
+            }
+            if (nb_missing == 0 or Clock_Monotonic::Get_Ticks() > deadline_ns)
+                break;
+            Wait(0.01);
+        }
+
+        if (nb_missing > 0)
+            log("WARNING: %d rank(s) did not report their timers within %g seconds.\n", nb_missing, timeout);
+    }
+
+#ifdef PARALLEL_MPI
+    // **********************************************************
+    MPI_Transport::MPI_Transport(MPI_Comm _communicator)
+    {
+        communicator = _communicator;
+    }
+
+    // **********************************************************
+    int MPI_Transport::Rank() const
+    {
+        int rank = 0;
+        MPI_Comm_rank(communicator, &rank);
+        return rank;
+    }
+
+    // **********************************************************
+    int MPI_Transport::Nb_Ranks() const
+    {
+        int nb_ranks = 1;
+        MPI_Comm_size(communicator, &nb_ranks);
+        return nb_ranks;
+    }
+
+    // **********************************************************
+    void MPI_Transport::Gather(const std::string &local, std::vector<std::string> &all)
+    /**
+     * Gather the buffers' sizes then the buffers (MPI_Gatherv).
+     */
+    {
+        const int rank     = Rank();
+        const int nb_ranks = Nb_Ranks();
+
+        int local_size = int(local.size());
+        std::vector<int> sizes(rank == 0 ? nb_ranks : 1, 0);
+        MPI_Gather(&local_size, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, communicator);
+
+        std::vector<int> displacements(sizes.size(), 0);
+        int total_size = 0;
+        if (rank == 0)
+        {
+            for (int i = 0 ; i < nb_ranks ; i++)
+            {
+                displacements[size_t(i)] = total_size;
+                total_size += sizes[size_t(i)];
+            }
+        }
+        std::vector<char> received(size_t(std::max(total_size, 1)));
+        MPI_Gatherv(const_cast<char *>(local.data()), local_size, MPI_CHAR,
+                    &received[0], &sizes[0], &displacements[0], MPI_CHAR, 0, communicator);
+
+        if (rank != 0)
+            return;
+        all.resize(size_t(nb_ranks));
+        for (int i = 0 ; i < nb_ranks ; i++)
+        {
+            all[size_t(i)].assign(&received[0] + displacements[size_t(i)], size_t(sizes[size_t(i)]));
+        }
+    }
+#endif // #ifdef PARALLEL_MPI
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,607 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cerrno>     // ENOMEM
+#include <cstdlib>
+#include <cstring>    // memset()
+#include <new>        // ::operator new
+#include <malloc.h>   // malloc_usable_size()
+
+/**
+ * Allocations are counted by wrappers of the allocation functions,
+ * substituted at link time by the program's link command:
+ *
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ *   -Wl,--wrap=posix_memalign,--wrap=aligned_alloc,--wrap=memalign
+ *   -Wl,--wrap=_Znwm,--wrap=_Znam,--wrap=_ZdlPv,--wrap=_ZdaPv,--wrap=_ZdlPvm,--wrap=_ZdaPvm
+ *   -Wl,--wrap=_ZnwmRKSt9nothrow_t,--wrap=_ZnamRKSt9nothrow_t
+ *   -Wl,--wrap=_ZdlPvRKSt9nothrow_t,--wrap=_ZdaPvRKSt9nothrow_t
+ *   -Wl,--wrap=_ZnwmSt11align_val_t,--wrap=_ZnamSt11align_val_t
+ *   -Wl,--wrap=_ZnwmSt11align_val_tRKSt9nothrow_t,--wrap=_ZnamSt11align_val_tRKSt9nothrow_t
+ *   -Wl,--wrap=_ZdlPvSt11align_val_t,--wrap=_ZdaPvSt11align_val_t
+ *   -Wl,--wrap=_ZdlPvmSt11align_val_t,--wrap=_ZdaPvmSt11align_val_t
+ *
+ * (the C++ ones are operator new, new[], delete, delete[], their
+ * sized versions on 64 bits platforms, their nothrow versions and
+ * the aligned versions of C++17). The linker redirects the
+ * calls of the objects and static libraries it links to __wrap_X(),
+ * and __wrap_X() calls the original X() through __real_X(). Without
+ * the flags, the wrappers are never called and cost nothing.
+ *
+ * Each thread counts in its own stack of frames, one per running
+ * timer, so a wrapper only touches thread-local storage: the
+ * innermost timer gets the allocation. A frame is added to its timer
+ * when the timer stops. The library's own allocations (timers'
+ * shards, call path nodes, trace buffers...) are made inside a
+ * Library_Allocations scope and are not counted.
+ */
+
+// The __real_X() only exist when linked with --wrap=X.
+extern "C"
+{
+    void *__real_malloc(size_t size) __attribute__((weak));
+    void *__real_calloc(size_t number, size_t size) __attribute__((weak));
+    void *__real_realloc(void *pointer, size_t size) __attribute__((weak));
+    void  __real_free(void *pointer) __attribute__((weak));
+    void *__real__Znwm(size_t size) __attribute__((weak));
+    void *__real__Znam(size_t size) __attribute__((weak));
+    void  __real__ZdlPv(void *pointer) __attribute__((weak));
+    void  __real__ZdaPv(void *pointer) __attribute__((weak));
+    int   __real_posix_memalign(void **pointer, size_t alignment, size_t size) __attribute__((weak));
+    void *__real_aligned_alloc(size_t alignment, size_t size) __attribute__((weak));
+    void *__real_memalign(size_t alignment, size_t size) __attribute__((weak));
+    void *__real__ZnwmRKSt9nothrow_t(size_t size, const std::nothrow_t &) __attribute__((weak));
+    void *__real__ZnamRKSt9nothrow_t(size_t size, const std::nothrow_t &) __attribute__((weak));
+    void  __real__ZdlPvRKSt9nothrow_t(void *pointer, const std::nothrow_t &) __attribute__((weak));
+    void  __real__ZdaPvRKSt9nothrow_t(void *pointer, const std::nothrow_t &) __attribute__((weak));
+    // The std::align_val_t of C++17 is passed as a size_t.
+    void *__real__ZnwmSt11align_val_t(size_t size, size_t alignment) __attribute__((weak));
+    void *__real__ZnamSt11align_val_t(size_t size, size_t alignment) __attribute__((weak));
+    void *__real__ZnwmSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const std::nothrow_t &) __attribute__((weak));
+    void *__real__ZnamSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const std::nothrow_t &) __attribute__((weak));
+    void  __real__ZdlPvSt11align_val_t(void *pointer, size_t alignment) __attribute__((weak));
+    void  __real__ZdaPvSt11align_val_t(void *pointer, size_t alignment) __attribute__((weak));
+
+    // glibc's allocator, for wrappers linked from a shared libtiming
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t number, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void  __libc_free(void *pointer);
+}
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Count heap allocations of the running timers
+    bool allocations_enabled = false;
+    // Set by the first wrapper called (the program was linked with --wrap)
+    bool allocations_wrapped = false;
+
+    // Deepest nesting of timers with their own frame
+    const int allocation_max_depth = 64;
+
+    // **********************************************************
+    struct Allocation_Frame
+    {
+        const Timer_Base *timer;
+        uint64_t nb_allocations;
+        uint64_t nb_frees;
+        uint64_t bytes;
+        int64_t  live_start;    // Thread's live bytes when the timer started
+        int64_t  live_peak;     // Largest live bytes since
+    };
+
+    // Calling thread's frames; the first one counts allocations outside any timer.
+    __thread Allocation_Frame allocation_frames[allocation_max_depth];
+    __thread int allocation_depth = 0;
+    // Bytes allocated minus bytes freed by the calling thread
+    __thread int64_t allocation_live_bytes = 0;
+    // Nesting of Library_Allocations scopes of the calling thread
+    __thread int allocation_library_scopes = 0;
+
+    // **********************************************************
+    inline void Count_Allocation(void *pointer, const size_t size)
+    {
+        if (not allocations_enabled or pointer == NULL or allocation_library_scopes != 0)
+            return;
+        Allocation_Frame &frame = allocation_frames[allocation_depth];
+        frame.nb_allocations++;
+        frame.bytes += size;
+        allocation_live_bytes += int64_t(malloc_usable_size(pointer));
+        if (allocation_live_bytes > frame.live_peak)
+            frame.live_peak = allocation_live_bytes;
+    }
+
+    // **********************************************************
+    inline void Count_Free(const size_t usable_size)
+    {
+        allocation_frames[allocation_depth].nb_frees++;
+        allocation_live_bytes -= int64_t(usable_size);
+    }
+
+    // **********************************************************
+    inline void Count_Free(void *pointer)
+    {
+        if (not allocations_enabled or pointer == NULL or allocation_library_scopes != 0)
+            return;
+        Count_Free(malloc_usable_size(pointer));
+    }
+
+    // **********************************************************
+    void Enable_Allocations()
+    /**
+     * Count the heap allocations (number, bytes and peak live bytes)
+     * of every timer, attributed to the innermost running timer of
+     * the allocating thread. The program must be linked with the
+     * wrappers (see above).
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        allocations_enabled = true;
+        timers_features |= FEATURE_ALLOCATIONS;
+    }
+
+    // **********************************************************
+    bool Allocations_Enabled()
+    {
+        return allocations_enabled;
+    }
+
+    // **********************************************************
+    Library_Allocations::Library_Allocations()
+    {
+        ++allocation_library_scopes;
+    }
+
+    // **********************************************************
+    Library_Allocations::~Library_Allocations()
+    {
+        --allocation_library_scopes;
+    }
+
+    // **********************************************************
+    void Allocations_Enter(const Timer_Base *timer)
+    {
+        if (allocation_depth + 1 >= allocation_max_depth)
+            return;
+        Allocation_Frame &frame = allocation_frames[++allocation_depth];
+        frame.timer          = timer;
+        frame.nb_allocations = 0;
+        frame.nb_frees       = 0;
+        frame.bytes          = 0;
+        frame.live_start     = allocation_live_bytes;
+        frame.live_peak      = allocation_live_bytes;
+    }
+
+    // **********************************************************
+    void Allocations_Exit(const Timer_Base *timer, AllocationCounts *&counts)
+    /**
+     * Add the calling thread's frame of "timer" to "counts". Ignored
+     * if "timer" has none (it was started before counting was enabled,
+     * or too deeply nested). Frames of timers started after "timer"
+     * and still running (stopped out of order) are popped with it and
+     * their allocations go to "timer".
+     */
+    {
+        int depth = allocation_depth;
+        while (depth > 0 and allocation_frames[depth].timer != timer)
+            depth--;
+        if (depth == 0)
+            return;
+
+        for ( ; allocation_depth > depth ; allocation_depth--)
+        {
+            const Allocation_Frame &inner = allocation_frames[allocation_depth];
+            Allocation_Frame &outer = allocation_frames[allocation_depth - 1];
+            outer.nb_allocations += inner.nb_allocations;
+            outer.nb_frees       += inner.nb_frees;
+            outer.bytes          += inner.bytes;
+            outer.live_peak       = std::max(outer.live_peak, inner.live_peak);
+        }
+
+        if (counts == NULL)
+        {
+            Library_Allocations library;
+            counts = new AllocationCounts;
+            memset(counts, 0, sizeof(AllocationCounts));
+        }
+
+        const Allocation_Frame &frame = allocation_frames[allocation_depth--];
+        counts->nb_calls++;
+        counts->nb_allocations += frame.nb_allocations;
+        counts->nb_frees       += frame.nb_frees;
+        counts->bytes          += frame.bytes;
+        counts->peak_live_bytes = std::max(counts->peak_live_bytes, uint64_t(frame.live_peak - frame.live_start));
+
+        // The enclosing timer's live bytes went as high.
+        Allocation_Frame &parent = allocation_frames[allocation_depth];
+        parent.live_peak = std::max(parent.live_peak, frame.live_peak);
+    }
+
+    // **********************************************************
+    bool Timer_Base::Get_Allocations(AllocationCounts &total) const
+    /**
+     * Sum of the timer's allocations over its calls (and threads);
+     * the peak is the largest of a single call. Return false if none
+     * were counted.
+     */
+    {
+        memset(&total, 0, sizeof(AllocationCounts));
+
+        const AllocationCounts *all[1 + TIMING_MAX_THREADS];
+        int nb = 0;
+        all[nb++] = cold->allocations;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                all[nb++] = cold->shards[i]->allocations;
+        }
+        for (int i = 0 ; i < nb ; i++)
+        {
+            if (all[i] == NULL)
+                continue;
+            total.nb_calls       += all[i]->nb_calls;
+            total.nb_allocations += all[i]->nb_allocations;
+            total.nb_frees       += all[i]->nb_frees;
+            total.bytes          += all[i]->bytes;
+            total.peak_live_bytes = std::max(total.peak_live_bytes, all[i]->peak_live_bytes);
+        }
+        return (total.nb_calls != 0);
+    }
+
+    // **********************************************************
+    void Print_Allocations(const char *s, const size_t longest_length)
+    /**
+     * Print, for each timer, the heap allocations made while it was
+     * the innermost running timer, and the largest growth of the
+     * live heap during one of its calls (nested timers included).
+     */
+    {
+        if (not allocations_enabled)
+            return;
+        if (not allocations_wrapped)
+        {
+            Report("%sNo allocation was counted: link the program with -Wl,--wrap=malloc,... (see Enable_Allocations()).\n\n", s);
+            return;
+        }
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|                Allocations                |   Frees    |  Peak live |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|   number   |  per call  |   bytes    | bytes/call |   number   |   bytes    |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            AllocationCounts total;
+            if (not timer.Get_Allocations(total))
+                continue;
+
+            Report("%s| ", s);
+            Report_Padded(timer.Get_Name().c_str(), longest_length);
+            Report(" | %10" PRIu64 " | %10.4g | %10.4g | %10.4g | %10" PRIu64 " | %10.4g |\n",
+                (uint64_t) total.nb_allocations,
+                double(total.nb_allocations) / double(total.nb_calls),
+                double(total.bytes),
+                double(total.bytes) / double(total.nb_calls),
+                (uint64_t) total.nb_frees,
+                double(total.peak_live_bytes));
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|\n\n");
+    }
+
+    // **********************************************************
+    bool Save_Allocations(const std::string &filename)
+    /**
+     * Save the table of Print_Allocations() to "filename" (CSV).
+     */
+    {
+        FILE *file = fopen(filename.c_str(), "w");
+        if (file == NULL)
+        {
+            log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+            return false;
+        }
+
+        fprintf(file, "# Timer, Calls, Allocations, Bytes allocated, Frees, Peak live bytes\n");
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            AllocationCounts total;
+            if (not timer.Get_Allocations(total))
+                continue;
+            fprintf(file, "\"%s\", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n", timer.Get_Name().c_str(),
+                    (uint64_t) total.nb_calls,
+                    (uint64_t) total.nb_allocations,
+                    (uint64_t) total.bytes,
+                    (uint64_t) total.nb_frees,
+                    (uint64_t) total.peak_live_bytes);
+        }
+        fclose(file);
+        return true;
+    }
+} // namespace timing
+
+// **************************************************************
+// Wrappers (see above). When libtiming is a shared library, the
+// program's link redirects its calls to them but theirs to
+// __real_X() can't be resolved, so they call glibc's allocator.
+extern "C"
+{
+    // **********************************************************
+    void *__wrap_malloc(size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real_malloc != NULL ? __real_malloc(size) : __libc_malloc(size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap_calloc(size_t number, size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real_calloc != NULL ? __real_calloc(number, size) : __libc_calloc(number, size));
+        timing::Count_Allocation(pointer, number * size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap_realloc(void *pointer, size_t size)
+    {
+        timing::allocations_wrapped = true;
+        const size_t old_size = (pointer == NULL ? 0 : malloc_usable_size(pointer));
+        void *new_pointer = (__real_realloc != NULL ? __real_realloc(pointer, size) : __libc_realloc(pointer, size));
+        // A failed realloc() leaves the block allocated.
+        if (new_pointer == NULL and size != 0)
+            return new_pointer;
+        if (timing::allocations_enabled and pointer != NULL)
+            timing::Count_Free(old_size);
+        timing::Count_Allocation(new_pointer, size);
+        return new_pointer;
+    }
+
+    // **********************************************************
+    int __wrap_posix_memalign(void **pointer, size_t alignment, size_t size)
+    {
+        timing::allocations_wrapped = true;
+        int error;
+        if (__real_posix_memalign != NULL)
+            error = __real_posix_memalign(pointer, alignment, size);
+        else
+        {
+            *pointer = __libc_memalign(alignment, size);
+            error = (*pointer == NULL ? ENOMEM : 0);
+        }
+        if (error == 0)
+            timing::Count_Allocation(*pointer, size);
+        return error;
+    }
+
+    // **********************************************************
+    void *__wrap_aligned_alloc(size_t alignment, size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real_aligned_alloc != NULL ? __real_aligned_alloc(alignment, size) : __libc_memalign(alignment, size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap_memalign(size_t alignment, size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real_memalign != NULL ? __real_memalign(alignment, size) : __libc_memalign(alignment, size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void __wrap_free(void *pointer)
+    {
+        timing::Count_Free(pointer);
+        if (__real_free != NULL)
+            __real_free(pointer);
+        else
+            __libc_free(pointer);
+    }
+
+    // **********************************************************
+    void *__wrap__Znwm(size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__Znwm != NULL ? __real__Znwm(size) : ::operator new(size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap__Znam(size_t size)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__Znam != NULL ? __real__Znam(size) : ::operator new[](size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void __wrap__ZdlPv(void *pointer)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdlPv != NULL)
+            __real__ZdlPv(pointer);
+        else
+            ::operator delete(pointer);
+    }
+
+    // **********************************************************
+    void __wrap__ZdaPv(void *pointer)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdaPv != NULL)
+            __real__ZdaPv(pointer);
+        else
+            ::operator delete[](pointer);
+    }
+
+    // **********************************************************
+    void *__wrap__ZnwmRKSt9nothrow_t(size_t size, const std::nothrow_t &nothrow)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__ZnwmRKSt9nothrow_t != NULL ? __real__ZnwmRKSt9nothrow_t(size, nothrow) : ::operator new(size, nothrow));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap__ZnamRKSt9nothrow_t(size_t size, const std::nothrow_t &nothrow)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__ZnamRKSt9nothrow_t != NULL ? __real__ZnamRKSt9nothrow_t(size, nothrow) : ::operator new[](size, nothrow));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void __wrap__ZdlPvRKSt9nothrow_t(void *pointer, const std::nothrow_t &nothrow)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdlPvRKSt9nothrow_t != NULL)
+            __real__ZdlPvRKSt9nothrow_t(pointer, nothrow);
+        else
+            ::operator delete(pointer, nothrow);
+    }
+
+    // **********************************************************
+    void __wrap__ZdaPvRKSt9nothrow_t(void *pointer, const std::nothrow_t &nothrow)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdaPvRKSt9nothrow_t != NULL)
+            __real__ZdaPvRKSt9nothrow_t(pointer, nothrow);
+        else
+            ::operator delete[](pointer, nothrow);
+    }
+
+    // **********************************************************
+    // Aligned new and delete (C++17). Only a program compiled as
+    // C++17 calls them, so __real_X() exists unless libtiming is a
+    // shared library: glibc's memalign() then gives the memory.
+    void *__wrap__ZnwmSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const std::nothrow_t &nothrow)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__ZnwmSt11align_val_tRKSt9nothrow_t != NULL ?
+                         __real__ZnwmSt11align_val_tRKSt9nothrow_t(size, alignment, nothrow) : __libc_memalign(alignment, size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap__ZnamSt11align_val_tRKSt9nothrow_t(size_t size, size_t alignment, const std::nothrow_t &nothrow)
+    {
+        timing::allocations_wrapped = true;
+        void *pointer = (__real__ZnamSt11align_val_tRKSt9nothrow_t != NULL ?
+                         __real__ZnamSt11align_val_tRKSt9nothrow_t(size, alignment, nothrow) : __libc_memalign(alignment, size));
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap__ZnwmSt11align_val_t(size_t size, size_t alignment)
+    {
+        if (__real__ZnwmSt11align_val_t == NULL)
+        {
+            void *pointer = __wrap__ZnwmSt11align_val_tRKSt9nothrow_t(size, alignment, std::nothrow);
+            if (pointer == NULL)
+                throw std::bad_alloc();
+            return pointer;
+        }
+        timing::allocations_wrapped = true;
+        void *pointer = __real__ZnwmSt11align_val_t(size, alignment);
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void *__wrap__ZnamSt11align_val_t(size_t size, size_t alignment)
+    {
+        if (__real__ZnamSt11align_val_t == NULL)
+        {
+            void *pointer = __wrap__ZnamSt11align_val_tRKSt9nothrow_t(size, alignment, std::nothrow);
+            if (pointer == NULL)
+                throw std::bad_alloc();
+            return pointer;
+        }
+        timing::allocations_wrapped = true;
+        void *pointer = __real__ZnamSt11align_val_t(size, alignment);
+        timing::Count_Allocation(pointer, size);
+        return pointer;
+    }
+
+    // **********************************************************
+    void __wrap__ZdlPvSt11align_val_t(void *pointer, size_t alignment)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdlPvSt11align_val_t != NULL)
+            __real__ZdlPvSt11align_val_t(pointer, alignment);
+        else
+            __libc_free(pointer);
+    }
+
+    // **********************************************************
+    void __wrap__ZdaPvSt11align_val_t(void *pointer, size_t alignment)
+    {
+        timing::Count_Free(pointer);
+        if (__real__ZdaPvSt11align_val_t != NULL)
+            __real__ZdaPvSt11align_val_t(pointer, alignment);
+        else
+            __libc_free(pointer);
+    }
+
+    // **********************************************************
+    // Sized delete (C++14) frees like the unsized one.
+    void __wrap__ZdlPvm(void *pointer, size_t)
+    {
+        __wrap__ZdlPv(pointer);
+    }
+
+    // **********************************************************
+    void __wrap__ZdaPvm(void *pointer, size_t)
+    {
+        __wrap__ZdaPv(pointer);
+    }
+
+    // **********************************************************
+    void __wrap__ZdlPvmSt11align_val_t(void *pointer, size_t, size_t alignment)
+    {
+        __wrap__ZdlPvSt11align_val_t(pointer, alignment);
+    }
+
+    // **********************************************************
+    void __wrap__ZdaPvmSt11align_val_t(void *pointer, size_t, size_t alignment)
+    {
+        __wrap__ZdaPvSt11align_val_t(pointer, alignment);
+    }
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,323 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <pthread.h>
+
+namespace timing
+{
+    extern std::string output_folder;
+    void Initialize_Timers_Storage();
+
+    // **********************************************************
+    struct OutputRecord
+    /**
+     * What Stop() hands to the background writer.
+     */
+    {
+        Timer_Base *timer;
+        uint64_t step;
+        uint64_t stop_realtime_ns;
+        uint64_t ticks;
+    };
+
+    // **********************************************************
+    struct OutputSlot
+    {
+        uint64_t sequence;
+        OutputRecord record;
+    };
+
+    // **********************************************************
+    class OutputQueue
+    /**
+     * Bounded lock-free multi-producer single-consumer queue.
+     * Each slot's sequence number tells whether it is free for
+     * the producer owning position "pos" (sequence == pos) or
+     * ready for the consumer (sequence == pos + 1).
+     */
+    {
+        public:
+            OutputSlot *slots;
+            uint64_t mask;
+            char padding0[TIMING_CACHE_LINE];
+            uint64_t enqueue_position;
+            char padding1[TIMING_CACHE_LINE];
+            uint64_t dequeue_position;
+            char padding2[TIMING_CACHE_LINE];
+
+            // **************************************************
+            void Init(const uint64_t size)
+            {
+                Library_Allocations library;
+                slots = new OutputSlot[size];
+                mask  = size - 1;
+                for (uint64_t i = 0 ; i < size ; i++)
+                {
+                    slots[i].sequence = i;
+                }
+                enqueue_position = 0;
+                dequeue_position = 0;
+            }
+
+            // **************************************************
+            uint64_t Size() const
+            {
+                return __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED) - __atomic_load_n(&dequeue_position, __ATOMIC_RELAXED);
+            }
+
+            // **************************************************
+            bool Try_Push(const OutputRecord &record)
+            {
+                uint64_t position = __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+                OutputSlot *slot;
+                while (true)
+                {
+                    slot = &slots[position & mask];
+                    const uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+                    const int64_t difference = int64_t(sequence) - int64_t(position);
+                    if (difference == 0)
+                    {
+                        if (__atomic_compare_exchange_n(&enqueue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                            break;
+                    }
+                    else if (difference < 0)
+                    {
+                        // Queue is full
+                        return false;
+                    }
+                    else
+                    {
+                        position = __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+                    }
+                }
+                slot->record = record;
+                __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+
+            // **************************************************
+            bool Try_Pop(OutputRecord &record)
+            {
+                const uint64_t position = dequeue_position;
+                OutputSlot &slot = slots[position & mask];
+                const uint64_t sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+                if (sequence != position + 1)
+                    return false;
+                record = slot.record;
+                __atomic_store_n(&slot.sequence, position + mask + 1, __ATOMIC_RELEASE);
+                __atomic_store_n(&dequeue_position, position + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+    };
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Timers output is written by a background thread
+    bool          asynchronous_output_enabled = false;
+    Output_Policy asynchronous_output_policy  = OUTPUT_BLOCK;
+    OutputQueue   output_queue;
+    pthread_t     output_writer_thread;
+    // Number of records written by the writer thread
+    uint64_t      output_nb_written = 0;
+    // Set to ask the writer thread to finish
+    bool          output_writer_stop = false;
+
+    // Sampling policy: above this fill ratio of the queue, only one
+    // record in "output_sample_rate" is kept.
+    const double   output_sample_threshold = 0.75;
+    const uint64_t output_sample_rate      = 8;
+
+    // **********************************************************
+    void Sleep_Briefly()
+    {
+        timespec to_wait, remaining;
+        to_wait.tv_sec  = 0;
+        to_wait.tv_nsec = 1000000; // 1 ms
+        nanosleep(&to_wait, &remaining);
+    }
+
+    // **********************************************************
+    void * Output_Writer(void *)
+    /**
+     * Background writer: format and write queued records in
+     * batches, flushing the files once the queue is drained.
+     */
+    {
+        std::vector<Timer_Base *> written_timers;
+        OutputRecord record;
+        while (true)
+        {
+            uint64_t nb_written = 0;
+            while (output_queue.Try_Pop(record))
+            {
+                record.timer->Write_Output_Line(record.step, record.stop_realtime_ns, record.ticks);
+                written_timers.push_back(record.timer);
+                ++nb_written;
+            }
+
+            if (nb_written != 0)
+            {
+                for (size_t i = 0 ; i < written_timers.size() ; i++)
+                {
+                    written_timers[i]->Flush_Output();
+                }
+                written_timers.clear();
+                __atomic_add_fetch(&output_nb_written, nb_written, __ATOMIC_RELEASE);
+            }
+            else if (__atomic_load_n(&output_writer_stop, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+            else
+            {
+                Sleep_Briefly();
+            }
+        }
+        return NULL;
+    }
+
+    // **********************************************************
+    void Enable_Asynchronous_Output(const Output_Policy policy, const uint64_t queue_size)
+    /**
+     * Write the timers output (see Enable_Timers_Output()) from a
+     * background thread. Stop() only queues a small record; "policy"
+     * chooses what happens when the queue (rounded up to a power of
+     * two) is full. Dropped records are reported by timing::Print().
+     */
+    {
+        if (asynchronous_output_enabled)
+            return;
+
+        uint64_t size = 1;
+        while (size < queue_size)
+        {
+            size *= 2;
+        }
+        output_queue.Init(size);
+        asynchronous_output_policy = policy;
+
+        if (pthread_create(&output_writer_thread, NULL, Output_Writer, NULL) != 0)
+        {
+            log("ERROR: Could not start the timers output writer thread!\n");
+            log("       Timers output will be written synchronously.\n");
+            return;
+        }
+
+        // Timers must outlive the writer thread: create their storage
+        // before registering the exit handler so it runs first.
+        Initialize_Timers_Storage();
+        atexit(Stop_Asynchronous_Output);
+
+        asynchronous_output_enabled = true;
+    }
+
+    // **********************************************************
+    void Push_Output_Record(Timer_Base *timer, const uint64_t calls, const uint64_t step, const uint64_t stop_realtime_ns, const uint64_t ticks)
+    /**
+     * Queue a line of "timer"'s output file. "calls" is the number of
+     * calls of the caller (its shard's for a threaded timer), used to
+     * sample the records with OUTPUT_SAMPLE.
+     */
+    {
+        if (asynchronous_output_policy == OUTPUT_SAMPLE
+            and double(output_queue.Size()) > output_sample_threshold * double(output_queue.mask + 1)
+            and calls % output_sample_rate != 0)
+        {
+            timer->Count_Dropped_Output();
+            return;
+        }
+
+        OutputRecord record;
+        record.timer            = timer;
+        record.step             = step;
+        record.stop_realtime_ns = stop_realtime_ns;
+        record.ticks            = ticks;
+        while (not output_queue.Try_Push(record))
+        {
+            if (asynchronous_output_policy != OUTPUT_BLOCK)
+            {
+                timer->Count_Dropped_Output();
+                return;
+            }
+            Sleep_Briefly();
+        }
+    }
+
+    // **********************************************************
+    void Flush_Asynchronous_Output()
+    /**
+     * Wait until every queued record is written.
+     */
+    {
+        if (not asynchronous_output_enabled)
+            return;
+
+        const uint64_t nb_queued = __atomic_load_n(&output_queue.enqueue_position, __ATOMIC_ACQUIRE);
+        while (__atomic_load_n(&output_nb_written, __ATOMIC_ACQUIRE) < nb_queued)
+        {
+            Sleep_Briefly();
+        }
+    }
+
+    // **********************************************************
+    void Stop_Asynchronous_Output()
+    /**
+     * Write the remaining records and stop the writer thread.
+     * Timers output is written synchronously afterward.
+     */
+    {
+        if (not asynchronous_output_enabled)
+            return;
+
+        __atomic_store_n(&output_writer_stop, true, __ATOMIC_RELEASE);
+        pthread_join(output_writer_thread, NULL);
+        asynchronous_output_enabled = false;
+    }
+
+    // **********************************************************
+    void Print_Asynchronous_Output(const char *s, const size_t longest_length)
+    /**
+     * Print the number of output records dropped for each timer,
+     * if any.
+     */
+    {
+        uint64_t total_dropped = 0;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            total_dropped += Get_Timer(id).Get_Dropped_Output();
+        }
+        if (total_dropped == 0)
+            return;
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("| Output records dropped |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            Report("%s| ", s);
+            Report_Padded(Get_Timer(id).Get_Name().c_str(), longest_length);
+            Report(" | %22" PRIu64 " |\n", (uint64_t) Get_Timer(id).Get_Dropped_Output());
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,413 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdio>  // snprintf()
+#include <cstdlib>
+#include <cstring> // strlen()
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Record Start()/Stop() pairs in per-thread call-path trees
+    bool call_path_enabled = false;
+    // Root of each thread's call-path tree, indexed by Thread_Index()
+    CallPathNode *call_path_roots[TIMING_MAX_THREADS];
+    // Innermost active node of the calling thread (top of its stack)
+    __thread CallPathNode *call_path_current = NULL;
+
+    // **********************************************************
+    CallPathNode::CallPathNode(const Timer_Base *_timer, CallPathNode *_parent)
+    {
+        timer   = _timer;
+        parent  = _parent;
+        counter = 0;
+        inclusive_ticks = 0;
+    }
+
+    // **********************************************************
+    CallPathNode::~CallPathNode()
+    {
+        Library_Allocations library;
+        for (size_t i = 0 ; i < children.size() ; i++)
+        {
+            delete children[i];
+        }
+    }
+
+    // **********************************************************
+    CallPathNode * CallPathNode::Child(const Timer_Base *_timer)
+    /**
+     * Return the child node for "_timer", creating it if needed.
+     * A node rarely has more than a few children, so a linear
+     * search is faster than any associative container.
+     */
+    {
+        for (size_t i = 0 ; i < children.size() ; i++)
+        {
+            if (children[i]->timer == _timer)
+                return children[i];
+        }
+        Library_Allocations library;
+        CallPathNode *child = new CallPathNode(_timer, this);
+        children.push_back(child);
+        return child;
+    }
+
+    // **********************************************************
+    const char * CallPathNode::Get_Name() const
+    {
+        return (timer == NULL ? "(root)" : timer->Get_Name().c_str());
+    }
+
+    // **********************************************************
+    bool CallPathNode::Is_Sampled() const
+    {
+        return (timer != NULL and timer->Is_Sampled());
+    }
+
+    // **********************************************************
+    double CallPathNode::Get_Sampling_Factor() const
+    /**
+     * A sampled timer only enters the call path on its timed calls:
+     * its nodes are extrapolated like Get_Estimated_Duration(), by
+     * the timer's number of calls over its number of timed calls.
+     */
+    {
+        if (not Is_Sampled() or timer->Get_Statistics().count == 0)
+            return 1.0;
+        return double(timer->Get_Counter()) / double(timer->Get_Statistics().count);
+    }
+
+    // **********************************************************
+    double CallPathNode::Get_Calls() const
+    /**
+     * Estimated number of calls through this node.
+     */
+    {
+        return double(counter) * Get_Sampling_Factor();
+    }
+
+    // **********************************************************
+    double CallPathNode::Get_Inclusive() const
+    /**
+     * Estimated inclusive duration of the node, in seconds.
+     */
+    {
+        if (timer == NULL)
+            return 0.0;
+        return double(inclusive_ticks) * timer->Get_Seconds_per_Tick() * Get_Sampling_Factor();
+    }
+
+    // **********************************************************
+    double CallPathNode::Get_Children_Inclusive() const
+    {
+        double sum = 0.0;
+        for (size_t i = 0 ; i < children.size() ; i++)
+        {
+            sum += children[i]->Get_Inclusive();
+        }
+        return sum;
+    }
+
+    // **********************************************************
+    void Enable_Call_Path()
+    /**
+     * Track a per-thread stack of active timers so that every
+     * Start()/Stop() pair becomes a node in a call-path tree.
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        call_path_enabled = true;
+        timers_features |= FEATURE_CALL_PATH;
+    }
+
+    // **********************************************************
+    bool Call_Path_Enabled()
+    {
+        return call_path_enabled;
+    }
+
+    // **********************************************************
+    void Call_Path_Enter(const Timer_Base *timer)
+    /**
+     * Push "timer" on the calling thread's stack.
+     */
+    {
+        if (call_path_current == NULL)
+        {
+            const int thread_index = Thread_Index();
+            if (call_path_roots[thread_index] == NULL)
+            {
+                Library_Allocations library;
+                call_path_roots[thread_index] = new CallPathNode(NULL, NULL);
+            }
+            call_path_current = call_path_roots[thread_index];
+        }
+
+        call_path_current = call_path_current->Child(timer);
+        ++call_path_current->counter;
+    }
+
+    // **********************************************************
+    void Call_Path_Exit(const Timer_Base *timer, const uint64_t ticks)
+    /**
+     * Pop "timer" from the calling thread's stack and add the
+     * Start()/Stop() duration to its node.
+     * If timers are not stopped in reverse order of starting, the
+     * ones still running above "timer" are closed without duration.
+     */
+    {
+        CallPathNode *node = call_path_current;
+        while (node != NULL and node->timer != timer)
+        {
+            node = node->parent;
+        }
+
+        // Timer was started before call path tracking was enabled.
+        if (node == NULL)
+            return;
+
+        node->inclusive_ticks += ticks;
+        call_path_current = node->parent;
+    }
+
+    // **********************************************************
+    void Call_Path_Stop_Running()
+    /**
+     * Stop the calling thread's running timers, innermost first.
+     */
+    {
+        while (call_path_current != NULL and call_path_current->timer != NULL)
+        {
+            CallPathNode *node = call_path_current;
+            const_cast<Timer_Base *>(node->timer)->Stop_Generic();
+            // Pop it even if it was not running anymore.
+            if (call_path_current == node)
+                call_path_current = node->parent;
+        }
+    }
+
+    // **********************************************************
+    double Call_Path_Descendants_Overhead(const CallPathNode *node)
+    /**
+     * Start()/Stop() cost of every call below "node", in seconds.
+     */
+    {
+        double sum = 0.0;
+        for (size_t i = 0 ; i < node->children.size() ; i++)
+        {
+            // Only timed calls enter the call path, and like in
+            // Get_Overhead() the calls skipped by sampling are neglected.
+            const CallPathNode *child = node->children[i];
+            sum += double(child->counter) * child->timer->Get_Overhead_per_Call();
+            sum += Call_Path_Descendants_Overhead(child);
+        }
+        return sum;
+    }
+
+    // **********************************************************
+    double Call_Path_Nested_Overhead(const CallPathNode *node, const Timer_Base *timer)
+    {
+        if (node->timer == timer)
+            return Call_Path_Descendants_Overhead(node);
+
+        double sum = 0.0;
+        for (size_t i = 0 ; i < node->children.size() ; i++)
+        {
+            sum += Call_Path_Nested_Overhead(node->children[i], timer);
+        }
+        return sum;
+    }
+
+    // **********************************************************
+    double Call_Path_Nested_Overhead(const Timer_Base *timer)
+    /**
+     * Start()/Stop() cost of the timers nested inside "timer", on
+     * every thread, in seconds: it falls inside "timer"'s duration.
+     */
+    {
+        double sum = 0.0;
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            if (call_path_roots[t] != NULL)
+                sum += Call_Path_Nested_Overhead(call_path_roots[t], timer);
+        }
+        return sum;
+    }
+
+    // **********************************************************
+    size_t Call_Path_Longest_Name(const CallPathNode *node, const size_t depth)
+    {
+        // Sampled timers are marked with " *"
+        size_t longest_length = 2*depth + strlen(node->Get_Name()) + (node->Is_Sampled() ? 2 : 0);
+        for (size_t i = 0 ; i < node->children.size() ; i++)
+        {
+            longest_length = std::max(longest_length, Call_Path_Longest_Name(node->children[i], depth+1));
+        }
+        return longest_length;
+    }
+
+    // **********************************************************
+    void Print_Call_Path_Line(const char *name,
+                              const char *mark,
+                              const size_t depth,
+                              const size_t longest_length,
+                              const double inclusive,
+                              const double exclusive,
+                              const double parent_inclusive,
+                              const uint64_t counter)
+    {
+        const double percent = (parent_inclusive > 0.0 ? inclusive / parent_inclusive * 100.0 : 100.0);
+        Report("| ");
+        Report_Repeat(' ', 2*depth);
+        Report("%s%s", name, mark);
+        Report_Repeat(' ', longest_length - std::min(longest_length, 2*depth + strlen(name) + strlen(mark)));
+        Report(" | %10.5g | %10.5g | %6.2f | %12" PRIu64 " |\n", inclusive,
+                                                             exclusive,
+                                                             percent,
+                                                             (uint64_t) counter);
+    }
+
+    // **********************************************************
+    void Print_Call_Path_Node(const CallPathNode *node,
+                              const size_t depth,
+                              const size_t longest_length,
+                              const double inclusive,
+                              const double parent_inclusive)
+    {
+        const double exclusive = std::max(0.0, inclusive - node->Get_Children_Inclusive());
+        Print_Call_Path_Line(node->Get_Name(), (node->Is_Sampled() ? " *" : ""), depth, longest_length,
+                             inclusive, exclusive, parent_inclusive, uint64_t(node->Get_Calls() + 0.5));
+
+        if (node->children.empty())
+            return;
+
+        for (size_t i = 0 ; i < node->children.size() ; i++)
+        {
+            const CallPathNode *child = node->children[i];
+            Print_Call_Path_Node(child, depth+1, longest_length, child->Get_Inclusive(), inclusive);
+        }
+
+        // Time spent in the node but not covered by any child timer
+        Print_Call_Path_Line("(untimed)", "", depth+1, longest_length, exclusive, exclusive, inclusive, 0);
+    }
+
+    // **********************************************************
+    void Print_Call_Path()
+    /**
+     * Print every thread's call-path tree with inclusive time,
+     * exclusive time, percentage of parent and untimed remainder.
+     * The main thread's root spans the total running time.
+     */
+    {
+        size_t longest_length = strlen("(untimed)") + 2;
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            if (call_path_roots[t] != NULL)
+                longest_length = std::max(longest_length, Call_Path_Longest_Name(call_path_roots[t], 0) + 2);
+        }
+        longest_length = std::max(longest_length, strlen("Call path"));
+
+        Report("|");
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|--------|--------------|\n");
+        Report("| ");
+        Report_Padded("Call path", longest_length);
+        Report(" | Inclusive  | Exclusive  | %% of   | Number times |\n");
+        Report("|");
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  seconds   |  seconds   | parent |    called    |\n");
+        Report("|");
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|--------|--------------|\n");
+
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            const CallPathNode *root = call_path_roots[t];
+            if (root == NULL)
+                continue;
+
+            // Threads other than the first one have no running time of their own.
+            const double root_inclusive = (t == 0 ? Get_Total_Duration() : root->Get_Children_Inclusive());
+            char thread_name[32];
+            snprintf(thread_name, sizeof(thread_name), "Thread %d", t);
+            const double exclusive = std::max(0.0, root_inclusive - root->Get_Children_Inclusive());
+            Print_Call_Path_Line(thread_name, "", 0, longest_length, root_inclusive, exclusive, root_inclusive, 1);
+            for (size_t i = 0 ; i < root->children.size() ; i++)
+            {
+                const CallPathNode *child = root->children[i];
+                Print_Call_Path_Node(child, 1, longest_length, child->Get_Inclusive(), root_inclusive);
+            }
+            if (t == 0)
+                Print_Call_Path_Line("(untimed)", "", 1, longest_length, exclusive, exclusive, root_inclusive, 0);
+        }
+
+        Report("|");
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|--------|--------------|\n\n");
+    }
+
+    // **********************************************************
+    void Export_Folded_Node(std::ofstream &file, const CallPathNode *node, const std::string &stack)
+    {
+        std::string name = node->Get_Name();
+        // ';' separates frames in the folded format
+        for (size_t i = 0 ; i < name.length() ; i++)
+        {
+            if (name[i] == ';')
+                name[i] = '_';
+        }
+        const std::string node_stack = stack + ";" + name;
+
+        const double exclusive = std::max(0.0, node->Get_Inclusive() - node->Get_Children_Inclusive());
+        const uint64_t microseconds = uint64_t(exclusive * 1.0e6);
+        if (microseconds > 0)
+            file << node_stack << " " << microseconds << "\n";
+
+        for (size_t i = 0 ; i < node->children.size() ; i++)
+        {
+            Export_Folded_Node(file, node->children[i], node_stack);
+        }
+    }
+
+    // **********************************************************
+    void Export_Folded_Stacks(const std::string &filename)
+    /**
+     * Save the call-path trees as folded stacks ("a;b;c value" lines,
+     * value being the exclusive time in microseconds), ready to be
+     * fed to flamegraph.pl.
+     */
+    {
+        std::ofstream file(filename.c_str(), std::ios_base::out);
+        if (not file.is_open())
+        {
+            log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+            return;
+        }
+
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            const CallPathNode *root = call_path_roots[t];
+            if (root == NULL)
+                continue;
+
+            const std::string thread_name = "Thread " + NumberToStr(t);
+            for (size_t i = 0 ; i < root->children.size() ; i++)
+            {
+                Export_Folded_Node(file, root->children[i], thread_name);
+            }
+        }
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,174 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>    // strcasecmp()
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Categories and maximum level enabled at runtime. Everything is
+    // enabled by default.
+    uint32_t timers_categories = 0xFFFFFFFFu;
+    int      timers_level      = TIMING_LEVEL_DEBUG;
+    // Cached for Timer_Enabled(): categories enabled at each level
+    uint32_t timers_level_masks[TIMING_NB_LEVELS] = {0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu};
+
+    // **********************************************************
+    void Update_Level_Masks()
+    {
+        for (int level = 0 ; level < TIMING_NB_LEVELS ; level++)
+        {
+            timers_level_masks[level] = (level <= timers_level ? timers_categories : 0);
+        }
+    }
+
+    // **********************************************************
+    void Set_Timers_Categories(const uint32_t categories)
+    /**
+     * Only enable timers (TIMER_START_LEVEL()) of "categories", a
+     * mask of TIMING_CATEGORY(n). Timers started with TIMER_START()
+     * are always enabled.
+     */
+    {
+        timers_categories = categories;
+        Update_Level_Masks();
+    }
+
+    // **********************************************************
+    void Enable_Timers_Categories(const uint32_t categories)
+    {
+        Set_Timers_Categories(timers_categories | categories);
+    }
+
+    // **********************************************************
+    void Disable_Timers_Categories(const uint32_t categories)
+    {
+        Set_Timers_Categories(timers_categories & ~categories);
+    }
+
+    // **********************************************************
+    void Set_Timers_Level(const int level)
+    /**
+     * Only enable timers of "level" or below (TIMING_LEVEL_COARSE,
+     * TIMING_LEVEL_NORMAL, TIMING_LEVEL_FINE or TIMING_LEVEL_DEBUG).
+     */
+    {
+        timers_level = level;
+        Update_Level_Masks();
+    }
+
+    // **********************************************************
+    uint32_t Get_Timers_Categories()
+    {
+        return timers_categories;
+    }
+
+    // **********************************************************
+    int Get_Timers_Level()
+    {
+        return timers_level;
+    }
+
+    // **********************************************************
+    uint32_t Parse_Categories(const char *value)
+    /**
+     * "all", "none", a mask ("0x...") or a comma separated list
+     * of category numbers ("0,2,5").
+     */
+    {
+        if (strcmp(value, "all") == 0)
+            return 0xFFFFFFFFu;
+        if (strcmp(value, "none") == 0)
+            return 0;
+        if (strncmp(value, "0x", 2) == 0)
+            return uint32_t(strtoul(value, NULL, 16));
+
+        uint32_t categories = 0;
+        const char *current = value;
+        while (*current != '\0')
+        {
+            char *end = NULL;
+            const long category = strtol(current, &end, 10);
+            if (end == current or category < 0 or category > 31)
+            {
+                log("WARNING: Invalid timer category in \"%s\", enabling all categories.\n", value);
+                return 0xFFFFFFFFu;
+            }
+            categories |= TIMING_CATEGORY(category);
+            current = (*end == ',' ? end + 1 : end);
+        }
+        return categories;
+    }
+
+    // **********************************************************
+    int Parse_Level(const char *value)
+    /**
+     * "coarse", "normal", "fine", "debug" (case insensitive, with or
+     * without the "TIMING_LEVEL_" prefix) or their number (0 to 3).
+     */
+    {
+        const char * const names[TIMING_NB_LEVELS] = {"coarse", "normal", "fine", "debug"};
+        const char *name = (strncasecmp(value, "TIMING_LEVEL_", 13) == 0 ? value + 13 : value);
+        for (int level = 0 ; level < TIMING_NB_LEVELS ; level++)
+        {
+            if (strcasecmp(name, names[level]) == 0)
+                return level;
+        }
+
+        char *end = NULL;
+        const long level = strtol(value, &end, 10);
+        if (end == value or *end != '\0' or level < 0 or level >= TIMING_NB_LEVELS)
+        {
+            log("WARNING: Invalid timer level \"%s\", enabling all levels.\n", value);
+            return TIMING_LEVEL_DEBUG;
+        }
+        return int(level);
+    }
+
+    // **********************************************************
+    class Categories_From_Environment
+    /**
+     * Read TIMING_CATEGORIES and TIMING_LEVEL when the library is
+     * loaded, so they apply without changing the program.
+     */
+    {
+        public:
+            Categories_From_Environment()
+            {
+                const char *categories = getenv("TIMING_CATEGORIES");
+                if (categories != NULL)
+                    timers_categories = Parse_Categories(categories);
+                const char *level = getenv("TIMING_LEVEL");
+                if (level != NULL)
+                    timers_level = Parse_Level(level);
+                Update_Level_Masks();
+            }
+    };
+    Categories_From_Environment categories_from_environment;
+
+    // **********************************************************
+    void Print_Timers_Categories()
+    /**
+     * Remind that some timers were disabled at runtime.
+     */
+    {
+        if (timers_categories == 0xFFFFFFFFu and timers_level >= TIMING_LEVEL_DEBUG)
+            return;
+        Report("Timers enabled: categories mask 0x%08x, level <= %d (TIMER_START_LEVEL() timers only)\n\n",
+            (unsigned int) timers_categories, timers_level);
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -15,8 +15,6 @@
 
 namespace timing
 {
-    extern std::map<std::string, Timer> TimersMap;
-
     // This is a timer that keeps track of the total running time.
     // The constructor starts it automatically.
     // This is needed for ETA calculation.
@@ -52,43 +50,45 @@ namespace timing
     /**
      * Return a string containing the clock's time in the format
      * Www Mmm dd hh:mm:ss.UUUUUU yyyy
+     */
+    {
+        char current_date[64];
+        const size_t length = Format_Time(current_date, sizeof(current_date));
+        return std::string(current_date, length);
+    }
+
+    // **********************************************************
+    size_t Clock::Format_Time(char *buffer, const size_t size) const
+    /**
+     * Write the clock's time to "buffer" like Get_Time(). Return the
+     * length written (at most size-1), like snprintf().
      *
-     * NOTE: ctime() does NOT return the microseconds part.
-     *       It must be added explicitly.
+     * NOTE: ctime()'s format does NOT have the microseconds part.
+     *       It must be added explicitly, before the year.
      */
     {
+        if (size == 0)
+            return 0;
+
         // We can't get a date/time string from a timespec. Convert
         // it to a time_t first.
-        time_t tmp_time = timer.tv_sec;
-
-        // ctime returns this format: "Www Mmm dd hh:mm:ss yyyy\n\0"
-        // thus a 26 length string (including the trailing newline '\n' and NULL '\0')
-        // So just copy the first 24 charaters
-        char c_current_date[26];
-        memcpy(c_current_date, ctime(&tmp_time), 26*sizeof(char));
-        // Remove the end of line character by setting it to NULL
-        c_current_date[24] = '\0';
-
-        // Store the year: we'll add sub-second values (microseconds)
-        char c_year[5];
-        strncpy(c_year, &(c_current_date[20]), 4);
-        c_year[4] = '\0';
-
-        // Clear the year from "c_current_date" (and the space before the year)
-        memset(&(c_current_date[19]), 0, 5*sizeof(char));
-
-        std::string current_date = c_current_date;
-
-        //log("c_year = %s\n", c_year);
-        // Put the microseconds before years
-        memset(c_current_date, 0, 26*sizeof(char));
-        const uint64_t microseconds = uint64_t(timer.tv_nsec / 1000L);
-        sprintf(c_current_date, ".%-6llu", microseconds);
-        current_date += std::string(c_current_date) + std::string(" ") + std::string(c_year);
-
-        // Add also microseconds
-
-        return current_date;
+        const time_t tmp_time = timer.tv_sec;
+        struct tm date;
+        localtime_r(&tmp_time, &date);
+
+        // ctime()'s format: "Www Mmm dd hh:mm:ss yyyy", the day padded
+        // with a space (strftime()'s "%e" is not C++98).
+        char week_month[16];
+        char time_of_day[16];
+        if (strftime(week_month, sizeof(week_month), "%a %b", &date) == 0)
+            week_month[0] = '\0';
+        if (strftime(time_of_day, sizeof(time_of_day), "%H:%M:%S", &date) == 0)
+            time_of_day[0] = '\0';
+
+        const long microseconds = long(timer.tv_nsec / 1000L);
+        const int written = snprintf(buffer, size, "%s %2d %s.%-6ld %d", week_month, date.tm_mday, time_of_day,
+                                     microseconds, date.tm_year + 1900);
+        return std::min(size_t(std::max(0, written)), size - 1);
     }
 
     // **********************************************************
@@ -142,23 +142,13 @@ namespace timing
     }
 
     // **********************************************************
-    void Clock::Get_Current_Time()
+    void Clock_Error(const char *clock_name)
+    /**
+     * Called by the clock sources when clock_gettime() fails.
+     */
     {
-        // "CLOCK_PROCESS_CPUTIME_ID" measure the time taken by the process on the CPU.
-        // If the process is sleeping (using timing::Wait() for example), the time passed
-        // sleeping will not be counted!
-        //const int return_value = clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &(this->timer));
-        // "CLOCK_REALTIME" might have trouble in 2038 and is affected by clock changes (NTP)
-        // It starts at epoc (1970)
-        const int return_value = clock_gettime(CLOCK_REALTIME, &(this->timer));
-        // "CLOCK_MONOTONIC" is reliable clock, but measures RELATIVE time!
-        // It does NOT start at epoc!
-        //const int return_value = clock_gettime(CLOCK_MONOTONIC, &(this->timer));
-        if (return_value != 0)
-        {
-            log("ERROR: Failed calling clock_gettime()\n");
-            abort();
-        }
+        log("ERROR: Failed calling clock_gettime() on the %s clock\n", clock_name);
+        abort();
     }
 
     // **********************************************************
@@ -15,8 +15,6 @@
 
 namespace timing
 {
-    extern std::map<std::string, Timer> TimersMap;
-
     // This is a timer that keeps track of the total running time.
     // The constructor starts it automatically.
     // This is needed for ETA calculation.
@@ -29,36 +27,249 @@ namespace timing
         duration         = _duration;
     }
 
+    // **********************************************************
+    size_t Format_Duration(const double seconds, char *buffer, const size_t size)
+    /**
+     * Write "seconds" to "buffer" like Duration_Human_Readable()
+     * ("1d02h03m04s", "03m04s", "04s"). Return the length written
+     * (at most size-1), like snprintf().
+     */
+    {
+        const uint64_t total   = uint64_t(std::max(0.0, seconds));
+        const uint64_t days    = total / days_to_sec;
+        const uint64_t hours   = (total % days_to_sec) / hours_to_sec;
+        const uint64_t minutes = (total % hours_to_sec) / min_to_sec;
+        const uint64_t secs    = total % min_to_sec;
+
+        int length;
+        if (days != 0)
+            length = snprintf(buffer, size, "%" PRIu64 "d%02" PRIu64 "h%02" PRIu64 "m%02" PRIu64 "s", (uint64_t) days,
+                              (uint64_t) hours, (uint64_t) minutes, (uint64_t) secs);
+        else if (hours != 0)
+            length = snprintf(buffer, size, "%02" PRIu64 "h%02" PRIu64 "m%02" PRIu64 "s",
+                              (uint64_t) hours, (uint64_t) minutes, (uint64_t) secs);
+        else if (minutes != 0)
+            length = snprintf(buffer, size, "%02" PRIu64 "m%02" PRIu64 "s", (uint64_t) minutes, (uint64_t) secs);
+        else
+            length = snprintf(buffer, size, "%02" PRIu64 "s", (uint64_t) secs);
+        return std::min(size_t(std::max(0, length)), (size == 0 ? 0 : size - 1));
+    }
+
     // **********************************************************
     std::string Eta::_Get_ETA(const double time, const int width, const char fill) const
     {
-        std::string eta_string("");
+        char eta_string[64] = "-";
 
         // Wait 0.5% before calculating an ETA to let the simulation stabilize.
-        if ((time - first_time)/duration < 5.0e-3)
-        {
-            eta_string = "-";
-        }
-        else
+        if ((time - first_time)/duration >= 5.0e-3)
         {
             // ETA: Estimated Time of Arrival (s)
             TimerTotal.Update_Duration();
             const double elapsed_time = TimerTotal.Get_Duration();
             const double eta = std::max(0.0, ((duration - first_time) / (time - first_time) - 1.0) * elapsed_time);
-
-            Timer tmp;
-            tmp.Clear();
-            tmp.Add_Seconds(eta);
-            eta_string = tmp.Duration_Human_Readable();
+            Format_Duration(eta, eta_string, sizeof(eta_string));
         }
 
         // Format the string
+        std::string formatted(eta_string);
         if (width != 0)
         {
-            eta_string.resize(width, fill);
+            formatted.resize(width, fill);
+        }
+
+        return formatted;
+    }
+
+    // **********************************************************
+    Eta_Estimator::Eta_Estimator(const double _first, const double _last, const Eta_Model _model, const double _parameter)
+    /**
+     * Estimate the time to go from "_first" to "_last" progress,
+     * starting now. See Eta_Model for "_model" and "_parameter"
+     * (0: the model's default).
+     */
+    {
+        first          = _first;
+        last           = _last;
+        progress       = _first;
+        progress_ticks = Clock_Monotonic::Get_Ticks();
+
+        average.Clear();
+        phase.Clear();
+        exponential_alpha    = 0.05;
+        exponential_mean     = 0.0;
+        exponential_variance = 0.0;
+        exponential_count    = 0;
+        window_position      = 0;
+        window_count         = 0;
+        Set_Model(_model, _parameter);
+    }
+
+    // **********************************************************
+    void Eta_Estimator::Set_Model(const Eta_Model _model, const double _parameter)
+    /**
+     * Every model is updated all along, so switching keeps the past
+     * updates. The exponential average's weight is the one given at
+     * construction (0.05 by default); switching to ETA_EXPONENTIAL
+     * with another weight restarts that average.
+     */
+    {
+        model     = _model;
+        parameter = _parameter;
+        if (model == ETA_EXPONENTIAL)
+        {
+            // Only a weight in (0, 1] replaces the current one
+            const bool has_weight = (parameter > 0.0 and parameter <= 1.0);
+            if (not has_weight)
+                parameter = exponential_alpha;
+            else if (parameter < exponential_alpha or parameter > exponential_alpha)
+            {
+                exponential_alpha = parameter;
+                exponential_count = 0;
+            }
+        }
+        if (model == ETA_WINDOW)
+            parameter = (parameter < 2.0 ? 64.0 : std::min(parameter, double(eta_max_window)));
+    }
+
+    // **********************************************************
+    void Eta_Estimator::New_Phase()
+    /**
+     * The cost of the progress changes from now on (new stage of the
+     * simulation, ...). Only affects ETA_PHASE.
+     */
+    {
+        phase.Clear();
+    }
+
+    // **********************************************************
+    void Eta_Estimator::_Update(const double _progress)
+    /**
+     * Record that "_progress" is reached now. Updates without
+     * progress are merged with the next one.
+     */
+    {
+        const uint64_t now = Clock_Monotonic::Get_Ticks();
+        const double delta_progress = _progress - progress;
+        if (delta_progress <= 0.0)
+            return;
+
+        const double seconds = double(now - progress_ticks) * Clock_Monotonic::Seconds_per_Tick();
+        const double cost    = seconds / delta_progress;
+        progress       = _progress;
+        progress_ticks = now;
+
+        average.Record(cost, delta_progress);
+        phase.Record(cost, delta_progress);
+
+        // Exponentially weighted mean and variance (Finch, 2009)
+        const double alpha = exponential_alpha;
+        if (exponential_count == 0)
+        {
+            exponential_mean     = cost;
+            exponential_variance = 0.0;
+        }
+        else
+        {
+            const double difference = cost - exponential_mean;
+            const double increment  = alpha * difference;
+            exponential_mean       += increment;
+            exponential_variance    = (1.0 - alpha) * (exponential_variance + difference * increment);
+        }
+        exponential_count++;
+
+        window_seconds[window_position]  = seconds;
+        window_progress[window_position] = delta_progress;
+        window_position = (window_position + 1) % eta_max_window;
+        window_count    = std::min(window_count + 1, eta_max_window);
+    }
+
+    // **********************************************************
+    bool Eta_Estimator::_Estimate(double &remaining, double &low, double &high) const
+    /**
+     * Seconds remaining to reach "last" and the bounds of its 95%
+     * confidence band: the uncertainty on the model's mean cost per
+     * unit of progress, assuming the remaining progress costs the
+     * same on average. Return false before the model has two updates.
+     */
+    {
+        double mean = 0.0, variance = 0.0, count = 0.0;
+        switch (model)
+        {
+            case ETA_AVERAGE:
+            case ETA_PHASE:
+            {
+                const Eta_Cost &cost = (model == ETA_AVERAGE ? average : phase);
+                mean     = cost.mean;
+                variance = (cost.weight > 0.0 ? cost.m2 / cost.weight : 0.0);
+                count    = double(cost.count);
+                break;
+            }
+            case ETA_EXPONENTIAL:
+            {
+                // Effective number of updates of the weighted average
+                const double alpha = exponential_alpha;
+                mean     = exponential_mean;
+                variance = exponential_variance;
+                count    = std::min(double(exponential_count), (2.0 - alpha) / alpha);
+                break;
+            }
+            case ETA_WINDOW:
+            {
+                const int size = std::min(window_count, int(parameter));
+                Eta_Cost cost;
+                cost.Clear();
+                for (int i = 1 ; i <= size ; i++)
+                {
+                    const int index = (window_position - i + eta_max_window) % eta_max_window;
+                    cost.Record(window_seconds[index] / window_progress[index], window_progress[index]);
+                }
+                mean     = cost.mean;
+                variance = (cost.weight > 0.0 ? cost.m2 / cost.weight : 0.0);
+                count    = double(cost.count);
+                break;
+            }
+        }
+        if (count < 2.0)
+            return false;
+
+        const double to_go = std::max(0.0, last - progress);
+        const double error = 1.96 * std::sqrt(variance / count);
+        remaining = to_go * mean;
+        low       = to_go * std::max(0.0, mean - error);
+        high      = to_go * (mean + error);
+        return true;
+    }
+
+    // **********************************************************
+    size_t Eta_Estimator::_Format(char *buffer, const size_t size) const
+    /**
+     * Write the estimate to "buffer" as "01h02m03s (58m10s-01h07m55s)",
+     * or "-" without an estimate. Return the length written (at most
+     * size-1), like snprintf().
+     */
+    {
+        if (size == 0)
+            return 0;
+
+        double remaining, low, high;
+        if (not _Estimate(remaining, low, high))
+        {
+            snprintf(buffer, size, "-");
+            return std::min(size_t(1), size - 1);
         }
 
-        return eta_string;
+        size_t length = Format_Duration(remaining, buffer, size);
+        if (length + 1 < size)
+            length += size_t(snprintf(buffer + length, size - length, " ("));
+        length = std::min(length, size - 1);
+        length += Format_Duration(low, buffer + length, size - length);
+        if (length + 1 < size)
+            length += size_t(snprintf(buffer + length, size - length, "-"));
+        length = std::min(length, size - 1);
+        length += Format_Duration(high, buffer + length, size - length);
+        if (length + 1 < size)
+            length += size_t(snprintf(buffer + length, size - length, ")"));
+        return std::min(length, size - 1);
     }
 
 } // namespace timing
@@ -0,0 +1,436 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <unistd.h>     // getpid(), gethostname()
+
+/**
+ * The summary holds timing::Print()'s main table and the statistics
+ * available for each timer, taken while the timers keep running:
+ *
+ * JSON:
+ *   {
+ *     "build": {"branch": "master", "sha": "...", "time": "..."},
+ *     "run": {"date": "...", "host": "...", "pid": 1234, "step": 1000, ...},
+ *     "timers": [{"name": "solver", "calls": 1000, "seconds": 10.2, ...}, ...]
+ *   }
+ *
+ * CSV: the "build" and "run" values as "# key: value" lines, then one
+ * row per timer. Values not measured are left empty.
+ */
+
+namespace timing
+{
+    // See Git_Info.cpp (generated dynamically from Git_Info.cpp_template & Makefile.rules)
+    extern const char *git_build_sha;
+    extern const char *git_build_branch;
+    extern const char *git_build_time;
+
+    extern Timer TimerTotal;
+    extern std::string output_folder;
+    extern uint64_t timers_step;
+    extern int nb_registered_threads;
+    extern uint32_t perf_available_events;
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Timers_Feature flags and their names
+    const uint32_t summary_feature_flags[] = {FEATURE_OUTPUT, FEATURE_CALL_PATH, FEATURE_FLIGHT_RECORDER,
+                                              FEATURE_TRACE, FEATURE_PERF_COUNTERS, FEATURE_ALLOCATIONS};
+    const char * const summary_features[]  = {"output", "call_path", "flight_recorder",
+                                              "trace", "perf_counters", "allocations"};
+    const int summary_nb_features = 6;
+    // Names of the Perf_Event and Resource_Usage_Field values
+    const char * const summary_perf_events[PERF_NB_EVENTS] = {"cycles", "instructions", "cache_references",
+                                                              "cache_misses", "branches", "branch_misses",
+                                                              "page_faults", "context_switches"};
+    const char * const summary_usage_fields[USAGE_NB_FIELDS] = {"wall_ns", "user_us", "system_us",
+                                                                "minor_faults", "major_faults",
+                                                                "voluntary_switches", "involuntary_switches",
+                                                                "maxrss_growth_kb"};
+    const double summary_percentiles[] = {50.0, 90.0, 99.0, 99.9};
+    const char * const summary_percentile_names[] = {"p50", "p90", "p99", "p99.9"};
+    const int summary_nb_percentiles = 4;
+
+    // **********************************************************
+    struct Summary_Timer
+    /**
+     * What the summary reports of a timer.
+     */
+    {
+        Live_Stats_Timer    totals;
+        DurationStatistics  statistics;
+        bool                has_percentiles;
+        double              percentiles[summary_nb_percentiles];
+        bool                has_perf;
+        uint64_t            perf[PERF_NB_EVENTS];
+        uint64_t            perf_calls;
+        bool                has_usage;
+        uint64_t            usage[USAGE_NB_FIELDS];
+        uint64_t            usage_calls;
+        bool                has_allocations;
+        AllocationCounts    allocations;
+    };
+
+    // **********************************************************
+    void Timer_Base::Get_Merged_Statistics(DurationStatistics &merged) const
+    /**
+     * Statistics of the timer's durations merged over its shards,
+     * without merging the shards (see Get_Live_Stats()).
+     */
+    {
+        merged = statistics;
+        if (not is_threaded)
+            return;
+        // Merge_Shards() may have already copied the shards in "statistics".
+        merged.Clear();
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                merged.Merge(cold->shards[i]->statistics);
+        }
+    }
+
+    // **********************************************************
+    void Get_Summary_Timer(const Timer_Base &timer, Summary_Timer &summary)
+    {
+        timer.Get_Live_Stats(summary.totals);
+        timer.Get_Merged_Statistics(summary.statistics);
+
+        // Shards' histograms are only merged by timing::Print().
+        summary.has_percentiles = (timer.Get_Histogram() != NULL and not timer.Is_Threaded());
+        for (int p = 0 ; p < summary_nb_percentiles ; p++)
+        {
+            summary.percentiles[p] = (summary.has_percentiles ? timer.Get_Percentile(summary_percentiles[p]) : 0.0);
+        }
+
+        summary.has_perf        = timer.Get_Perf_Counts(summary.perf, summary.perf_calls);
+        summary.has_usage       = timer.Get_Resource_Usage(summary.usage, summary.usage_calls);
+        summary.has_allocations = timer.Get_Allocations(summary.allocations);
+    }
+
+    // **********************************************************
+    double Summary_Total_Seconds()
+    /**
+     * Running time so far (TimerTotal keeps running).
+     */
+    {
+        TimerTotal.Update_Duration();
+        return TimerTotal.Get_Duration();
+    }
+
+    // **********************************************************
+    void Write_JSON_String(std::ostream &stream, const std::string &text)
+    {
+        stream << '"';
+        for (size_t i = 0 ; i < text.length() ; i++)
+        {
+            const unsigned char c = (unsigned char) text[i];
+            if (c == '"' or c == '\\')
+                stream << '\\' << char(c);
+            else if (c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int) c);
+                stream << escaped;
+            }
+            else
+                stream << char(c);
+        }
+        stream << '"';
+    }
+
+    // **********************************************************
+    void Write_CSV_String(std::ostream &stream, const std::string &text)
+    {
+        stream << '"';
+        for (size_t i = 0 ; i < text.length() ; i++)
+        {
+            if (text[i] == '"')
+                stream << '"';
+            stream << text[i];
+        }
+        stream << '"';
+    }
+
+    // **********************************************************
+    std::string Summary_Date()
+    {
+        Clock now;
+        const uint64_t realtime_ns = Clock_Realtime::Get_Ticks();
+        now.Add_sec(time_t(realtime_ns / uint64_t(TenToNine)));
+        now.Add_nsec(long(realtime_ns % uint64_t(TenToNine)));
+        return now.Get_Time();
+    }
+
+    // **********************************************************
+    std::string Summary_Host()
+    {
+        char host[256];
+        if (gethostname(host, sizeof(host)) != 0)
+            return std::string("");
+        host[sizeof(host) - 1] = '\0';
+        return std::string(host);
+    }
+
+    // **********************************************************
+    std::vector<std::string> Summary_Features()
+    /**
+     * Names of the enabled features.
+     */
+    {
+        std::vector<std::string> features;
+        for (int f = 0 ; f < summary_nb_features ; f++)
+        {
+            if ((timers_features & summary_feature_flags[f]) != 0)
+                features.push_back(summary_features[f]);
+        }
+        if (Timers_Resource_Usage_Period() != 0)
+            features.push_back("resource_usage");
+        return features;
+    }
+
+    // **********************************************************
+    void Write_Summary_JSON(std::ostream &stream, const uint64_t nt)
+    /**
+     * Write the summary (see above) as JSON to "stream", without
+     * stopping the timers. "nt" is the number of time steps done so
+     * far, as for timing::Print(). Calls in progress are not counted.
+     */
+    {
+        const std::streamsize precision = stream.precision(10);
+        const double total_seconds = Summary_Total_Seconds();
+
+        stream << "{\n";
+        stream << "  \"build\": {\"library\": \"timing\", \"branch\": ";
+        Write_JSON_String(stream, git_build_branch);
+        stream << ", \"sha\": ";
+        Write_JSON_String(stream, git_build_sha);
+        stream << ", \"time\": ";
+        Write_JSON_String(stream, git_build_time);
+        stream << "},\n";
+
+        stream << "  \"run\": {\"date\": ";
+        Write_JSON_String(stream, Summary_Date());
+        stream << ", \"host\": ";
+        Write_JSON_String(stream, Summary_Host());
+        stream << ", \"pid\": " << int(getpid())
+               << ", \"step\": " << timers_step
+               << ", \"nb_time_steps\": " << nt
+               << ", \"total_seconds\": " << total_seconds
+               << ", \"threaded\": " << (Threaded_Timers_Enabled() ? "true" : "false")
+               << ", \"nb_threads\": " << std::max(1, nb_registered_threads)
+               << ", \"features\": [";
+        const std::vector<std::string> features = Summary_Features();
+        for (size_t f = 0 ; f < features.size() ; f++)
+        {
+            stream << (f == 0 ? "" : ", ") << '"' << features[f] << '"';
+        }
+        stream << "], \"categories\": " << Get_Timers_Categories()
+               << ", \"level\": " << Get_Timers_Level()
+               << ", \"output_folder\": ";
+        Write_JSON_String(stream, output_folder);
+        stream << "},\n";
+
+        stream << "  \"timers\": [";
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            Summary_Timer summary;
+            Get_Summary_Timer(timer, summary);
+            const double seconds_per_tick = timer.Get_Seconds_per_Tick();
+
+            stream << (id == 0 ? "\n" : ",\n") << "    {\"name\": ";
+            Write_JSON_String(stream, timer.Get_Name());
+            stream << ", \"calls\": " << summary.totals.calls
+                   << ", \"timed_calls\": " << summary.totals.timed_calls
+                   << ", \"sampling_period\": " << timer.Get_Sampling_Period()
+                   << ", \"seconds\": " << summary.totals.seconds
+                   << ", \"seconds_per_step\": " << (nt == 0 ? 0.0 : summary.totals.seconds / double(nt))
+                   << ", \"percent\": " << (total_seconds <= 0.0 ? 0.0 : summary.totals.seconds / total_seconds * 100.0);
+            if (summary.statistics.count != 0)
+            {
+                stream << ", \"min\": "    << double(summary.statistics.min) * seconds_per_tick
+                       << ", \"mean\": "   << summary.statistics.mean * seconds_per_tick
+                       << ", \"stddev\": " << std::sqrt(summary.statistics.Variance()) * seconds_per_tick
+                       << ", \"max\": "    << double(summary.statistics.max) * seconds_per_tick;
+            }
+            for (int p = 0 ; summary.has_percentiles and p < summary_nb_percentiles ; p++)
+            {
+                stream << ", \"" << summary_percentile_names[p] << "\": " << summary.percentiles[p];
+            }
+            if (summary.has_perf)
+            {
+                stream << ", \"perf\": {\"calls\": " << summary.perf_calls;
+                for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+                {
+                    if ((perf_available_events & (1u << e)) != 0)
+                        stream << ", \"" << summary_perf_events[e] << "\": " << summary.perf[e];
+                }
+                stream << "}";
+            }
+            if (summary.has_usage)
+            {
+                stream << ", \"resource_usage\": {\"calls\": " << summary.usage_calls;
+                for (int f = 0 ; f < USAGE_NB_FIELDS ; f++)
+                {
+                    stream << ", \"" << summary_usage_fields[f] << "\": " << summary.usage[f];
+                }
+                stream << "}";
+            }
+            if (summary.has_allocations)
+            {
+                stream << ", \"allocations\": {\"calls\": " << summary.allocations.nb_calls
+                       << ", \"allocations\": "     << summary.allocations.nb_allocations
+                       << ", \"bytes\": "           << summary.allocations.bytes
+                       << ", \"frees\": "           << summary.allocations.nb_frees
+                       << ", \"peak_live_bytes\": " << summary.allocations.peak_live_bytes << "}";
+            }
+            stream << "}";
+        }
+        stream << "\n  ]\n}\n";
+        stream.precision(precision);
+    }
+
+    // **********************************************************
+    void Write_Summary_CSV(std::ostream &stream, const uint64_t nt)
+    /**
+     * Write the summary (see above) as CSV to "stream", without
+     * stopping the timers. See Write_Summary_JSON().
+     */
+    {
+        const std::streamsize precision = stream.precision(10);
+        const double total_seconds = Summary_Total_Seconds();
+
+        stream << "# branch: "        << git_build_branch << "\n";
+        stream << "# sha: "           << git_build_sha << "\n";
+        stream << "# build time: "    << git_build_time << "\n";
+        stream << "# date: "          << Summary_Date() << "\n";
+        stream << "# host: "          << Summary_Host() << "\n";
+        stream << "# pid: "           << int(getpid()) << "\n";
+        stream << "# step: "          << timers_step << "\n";
+        stream << "# nb time steps: " << nt << "\n";
+        stream << "# total seconds: " << total_seconds << "\n";
+        stream << "# threads: "       << (Threaded_Timers_Enabled() ? std::max(1, nb_registered_threads) : 1) << "\n";
+        const std::vector<std::string> features = Summary_Features();
+        stream << "# features:";
+        for (size_t f = 0 ; f < features.size() ; f++)
+            stream << " " << features[f];
+        stream << "\n";
+
+        stream << "# Timer, Calls, Timed calls, Sampling period, Seconds, Seconds per step, % of total, "
+                  "Min (s), Mean (s), Stddev (s), Max (s)";
+        for (int p = 0 ; p < summary_nb_percentiles ; p++)
+            stream << ", " << summary_percentile_names[p] << " (s)";
+        stream << ", Perf calls";
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+            stream << ", " << summary_perf_events[e];
+        stream << ", Usage calls";
+        for (int f = 0 ; f < USAGE_NB_FIELDS ; f++)
+            stream << ", " << summary_usage_fields[f];
+        stream << ", Allocation calls, Allocations, Bytes allocated, Frees, Peak live bytes\n";
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            Summary_Timer summary;
+            Get_Summary_Timer(timer, summary);
+            const double seconds_per_tick = timer.Get_Seconds_per_Tick();
+
+            Write_CSV_String(stream, timer.Get_Name());
+            stream << ", " << summary.totals.calls
+                   << ", " << summary.totals.timed_calls
+                   << ", " << timer.Get_Sampling_Period()
+                   << ", " << summary.totals.seconds
+                   << ", " << (nt == 0 ? 0.0 : summary.totals.seconds / double(nt))
+                   << ", " << (total_seconds <= 0.0 ? 0.0 : summary.totals.seconds / total_seconds * 100.0);
+            if (summary.statistics.count != 0)
+                stream << ", " << double(summary.statistics.min) * seconds_per_tick
+                       << ", " << summary.statistics.mean * seconds_per_tick
+                       << ", " << std::sqrt(summary.statistics.Variance()) * seconds_per_tick
+                       << ", " << double(summary.statistics.max) * seconds_per_tick;
+            else
+                stream << ", , , , ";
+            for (int p = 0 ; p < summary_nb_percentiles ; p++)
+            {
+                stream << ", ";
+                if (summary.has_percentiles)
+                    stream << summary.percentiles[p];
+            }
+            stream << ", ";
+            if (summary.has_perf)
+                stream << summary.perf_calls;
+            for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+            {
+                stream << ", ";
+                if (summary.has_perf and (perf_available_events & (1u << e)) != 0)
+                    stream << summary.perf[e];
+            }
+            stream << ", ";
+            if (summary.has_usage)
+                stream << summary.usage_calls;
+            for (int f = 0 ; f < USAGE_NB_FIELDS ; f++)
+            {
+                stream << ", ";
+                if (summary.has_usage)
+                    stream << summary.usage[f];
+            }
+            if (summary.has_allocations)
+                stream << ", " << summary.allocations.nb_calls
+                       << ", " << summary.allocations.nb_allocations
+                       << ", " << summary.allocations.bytes
+                       << ", " << summary.allocations.nb_frees
+                       << ", " << summary.allocations.peak_live_bytes;
+            else
+                stream << ", , , , , ";
+            stream << "\n";
+        }
+        stream.precision(precision);
+    }
+
+    // **********************************************************
+    bool Export_Summary(const uint64_t nt, const std::string &basename)
+    /**
+     * Write the summary to "<basename>.json" and "<basename>.csv",
+     * by default "summary" in the output folder (see
+     * TIMERS_ENABLE_OUTPUT()), else in the current folder. Can be
+     * called at any time (at checkpoints, ...): the timers keep
+     * running. Return false if a file could not be written.
+     */
+    {
+        std::string base(basename);
+        if (base.empty())
+            base = (output_folder.empty() ? std::string("summary") : output_folder + "/summary");
+
+        bool is_written = true;
+        const std::string extensions[2] = {".json", ".csv"};
+        for (int i = 0 ; i < 2 ; i++)
+        {
+            const std::string filename = base + extensions[i];
+            std::ofstream file(filename.c_str());
+            if (not file.is_open())
+            {
+                log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+                is_written = false;
+                continue;
+            }
+            if (i == 0)
+                Write_Summary_JSON(file, nt);
+            else
+                Write_Summary_CSV(file, nt);
+            file.close();
+            is_written = is_written and not file.fail();
+        }
+        return is_written;
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
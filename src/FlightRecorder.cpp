@@ -0,0 +1,344 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>   // strncpy()
+#include <csignal>   // sigaction()
+#include <fcntl.h>   // open()
+#include <unistd.h>  // write(), pwrite(), lseek(), close()
+#include <new>       // Placement new
+
+/**
+ * Flight recorder dump file format (native endianness):
+ *
+ *   char     magic[8]          "TIMINGFR"
+ *   uint32_t version           1
+ *   uint32_t nb_timers
+ *   uint64_t monotonic_ns      CLOCK_MONOTONIC at dump time
+ *   uint64_t realtime_ns       CLOCK_REALTIME at dump time
+ *   nb_timers times:
+ *     uint32_t id
+ *     uint32_t name_length
+ *     double   seconds_per_tick
+ *     char     name[name_length]       At most 128 characters
+ *   uint32_t nb_threads
+ *   uint32_t reserved
+ *   nb_threads times:
+ *     uint32_t     thread_index
+ *     uint32_t     reserved
+ *     uint64_t     nb_records
+ *     FlightRecord records[nb_records]     Oldest first
+ */
+
+namespace timing
+{
+    extern uint64_t timers_step;
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Record Start()/Stop() pairs in per-thread flight recorder rings
+    bool flight_recorder_enabled = false;
+    // Number of records in each thread's ring (power of two)
+    uint64_t flight_recorder_nb_records = 0;
+    // Ring of each thread, indexed by Thread_Index()
+    FlightRecorderRing *flight_recorder_rings[TIMING_MAX_THREADS];
+    // Calling thread's ring (NULL until its first record)
+    __thread FlightRecorderRing *flight_recorder_ring = NULL;
+    // Longest name of a timer saved in a dump
+    const size_t flight_recorder_max_name = 128;
+    struct Flight_Recorder_Timer
+    {
+        double   seconds_per_tick;
+        uint32_t name_length;
+        char     name[flight_recorder_max_name];
+    };
+    // Timers of the table, copied when they are created since the
+    // signal handlers can't read their std::string names.
+    Flight_Recorder_Timer flight_recorder_timers[TIMING_MAX_TIMERS];
+    uint32_t flight_recorder_nb_timers = 0;
+    // File written by the signal handlers. Copied at installation
+    // since the handlers can't allocate.
+    char flight_recorder_signal_filename[4096];
+    char flight_recorder_crash_filename[4096];
+
+    // **********************************************************
+    FlightRecorderRing::FlightRecorderRing(const uint64_t nb_records)
+    {
+        records  = new FlightRecord[nb_records];
+        mask     = nb_records - 1;
+        position = 0;
+        memset(records, 0, nb_records*sizeof(FlightRecord));
+    }
+
+    // **********************************************************
+    FlightRecorderRing::~FlightRecorderRing()
+    {
+        Library_Allocations library;
+        delete[] records;
+    }
+
+    // **********************************************************
+    void Enable_Flight_Recorder(const uint64_t nb_records_per_thread)
+    /**
+     * Keep the last "nb_records_per_thread" Start()/Stop() pairs of
+     * every thread in memory (rounded up to a power of two). They
+     * can be saved with Dump_Flight_Recorder(), on a signal or when
+     * the program crashes.
+     */
+    {
+        uint64_t nb_records = 1;
+        while (nb_records < nb_records_per_thread)
+        {
+            nb_records *= 2;
+        }
+        flight_recorder_nb_records = nb_records;
+        flight_recorder_enabled = true;
+        timers_features |= FEATURE_FLIGHT_RECORDER;
+    }
+
+    // **********************************************************
+    bool Flight_Recorder_Enabled()
+    {
+        return flight_recorder_enabled;
+    }
+
+    // **********************************************************
+    void Flight_Recorder_Add_Timer(const Timer_Base &timer)
+    /**
+     * Copy the name of a new timer of the table for the dumps. Called
+     * (under the table's lock) whether the recorder is enabled or not.
+     */
+    {
+        const Timer_Id id = timer.Get_Id();
+        if (id >= TIMING_MAX_TIMERS)
+            return;
+        Flight_Recorder_Timer &copy = flight_recorder_timers[id];
+        copy.seconds_per_tick = timer.Get_Seconds_per_Tick();
+        copy.name_length = uint32_t(std::min(timer.Get_Name().length(), flight_recorder_max_name));
+        memcpy(copy.name, timer.Get_Name().data(), copy.name_length);
+        if (id >= flight_recorder_nb_timers)
+            __atomic_store_n(&flight_recorder_nb_timers, id + 1, __ATOMIC_RELEASE);
+    }
+
+    // **********************************************************
+    void Flight_Recorder_Record(const uint32_t timer_id, const uint64_t start_ticks, const uint64_t duration_ticks)
+    {
+        // TimerTotal is not in the table.
+        if (timer_id == invalid_timer_id)
+            return;
+        FlightRecorderRing *ring = flight_recorder_ring;
+        if (ring == NULL)
+            ring = flight_recorder_ring = flight_recorder_rings[Thread_Index()];
+        if (ring == NULL)
+        {
+            Library_Allocations library;
+            // Rings of different threads must not share a cache line.
+            void *memory = NULL;
+            if (posix_memalign(&memory, TIMING_CACHE_LINE, sizeof(FlightRecorderRing)) != 0)
+            {
+                log("ERROR: Could not allocate flight recorder for thread %d!\n", Thread_Index());
+                abort();
+            }
+            ring = new (memory) FlightRecorderRing(flight_recorder_nb_records);
+            flight_recorder_rings[Thread_Index()] = ring;
+            flight_recorder_ring = ring;
+        }
+        ring->Record(timer_id, start_ticks, duration_ticks, timers_step);
+    }
+
+    // **********************************************************
+    bool Write_All(const int fd, const void *buffer, const size_t size)
+    /**
+     * write() until everything is written. Async-signal-safe.
+     */
+    {
+        const char *data = static_cast<const char *>(buffer);
+        size_t written = 0;
+        while (written < size)
+        {
+            const ssize_t return_value = write(fd, data + written, size - written);
+            if (return_value <= 0)
+                return false;
+            written += size_t(return_value);
+        }
+        return true;
+    }
+
+    // **********************************************************
+    bool Dump_Flight_Recorder_To_File(const char *filename)
+    /**
+     * Write every thread's ring to "filename". Only uses
+     * async-signal-safe functions so it can run in a signal handler.
+     * The other threads keep recording meanwhile: records their rings
+     * overwrite while being copied are left out of the dump.
+     */
+    {
+        const int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+
+        bool ok = true;
+        const char magic[8] = {'T','I','M','I','N','G','F','R'};
+        const uint32_t version   = 1;
+        const uint32_t nb_timers = __atomic_load_n(&flight_recorder_nb_timers, __ATOMIC_ACQUIRE);
+        const uint64_t monotonic_ns = Clock_Monotonic::Get_Ticks();
+        const uint64_t realtime_ns  = Clock_Realtime::Get_Ticks();
+        ok = ok and Write_All(fd, magic, sizeof(magic));
+        ok = ok and Write_All(fd, &version, sizeof(version));
+        ok = ok and Write_All(fd, &nb_timers, sizeof(nb_timers));
+        ok = ok and Write_All(fd, &monotonic_ns, sizeof(monotonic_ns));
+        ok = ok and Write_All(fd, &realtime_ns, sizeof(realtime_ns));
+
+        for (Timer_Id id = 0 ; id < nb_timers ; id++)
+        {
+            const Flight_Recorder_Timer &timer = flight_recorder_timers[id];
+            ok = ok and Write_All(fd, &id, sizeof(id));
+            ok = ok and Write_All(fd, &timer.name_length, sizeof(timer.name_length));
+            ok = ok and Write_All(fd, &timer.seconds_per_tick, sizeof(timer.seconds_per_tick));
+            ok = ok and Write_All(fd, timer.name, timer.name_length);
+        }
+
+        uint32_t nb_threads = 0;
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            if (flight_recorder_rings[t] != NULL)
+                ++nb_threads;
+        }
+        const uint32_t reserved = 0;
+        ok = ok and Write_All(fd, &nb_threads, sizeof(nb_threads));
+        ok = ok and Write_All(fd, &reserved, sizeof(reserved));
+
+        for (int t = 0 ; t < TIMING_MAX_THREADS ; t++)
+        {
+            const FlightRecorderRing *ring = flight_recorder_rings[t];
+            if (ring == NULL)
+                continue;
+
+            // Records are numbered by "position" when written; the ring
+            // holds the last "size" of them, the oldest first.
+            const uint64_t size  = ring->mask + 1;
+            const uint64_t end   = __atomic_load_n(&ring->position, __ATOMIC_ACQUIRE);
+            uint64_t       index = (end < size ? 0 : end - size);
+            const uint32_t thread_index = uint32_t(t);
+            ok = ok and Write_All(fd, &thread_index, sizeof(thread_index));
+            ok = ok and Write_All(fd, &reserved, sizeof(reserved));
+
+            // Rewritten below, once the number of intact records is known
+            const off_t nb_records_offset = lseek(fd, 0, SEEK_CUR);
+            uint64_t nb_records = 0;
+            ok = ok and nb_records_offset >= 0;
+            ok = ok and Write_All(fd, &nb_records, sizeof(nb_records));
+
+            // Copy the records by batches. Once a batch is copied, the
+            // position tells which of its slots the thread may have
+            // rewritten meanwhile: record "i" is lost as soon as record
+            // "i + size" starts being written.
+            FlightRecord batch[64];
+            const uint64_t batch_size = sizeof(batch) / sizeof(batch[0]);
+            while (ok and index < end)
+            {
+                const uint64_t n = std::min(end - index, batch_size);
+                for (uint64_t i = 0 ; i < n ; i++)
+                {
+                    batch[i] = ring->records[(index + i) & ring->mask];
+                }
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                const uint64_t position      = __atomic_load_n(&ring->position, __ATOMIC_ACQUIRE);
+                const uint64_t oldest_intact = (position < size ? 0 : position - size + 1);
+                const uint64_t nb_lost       = (oldest_intact > index ? std::min(n, oldest_intact - index) : 0);
+                ok = ok and Write_All(fd, batch + nb_lost, (n - nb_lost)*sizeof(FlightRecord));
+                nb_records += n - nb_lost;
+                index += n;
+            }
+            ok = ok and pwrite(fd, &nb_records, sizeof(nb_records), nb_records_offset) == ssize_t(sizeof(nb_records));
+        }
+
+        close(fd);
+        return ok;
+    }
+
+    // **********************************************************
+    bool Dump_Flight_Recorder(const std::string &filename)
+    /**
+     * Save the flight recorder's content to "filename".
+     */
+    {
+        if (not flight_recorder_enabled)
+        {
+            log("WARNING: Flight recorder is not enabled, nothing to dump.\n");
+            return false;
+        }
+
+        const bool ok = Dump_Flight_Recorder_To_File(filename.c_str());
+        if (not ok)
+            log("ERROR: Could not save flight recorder to \"%s\"!\n", filename.c_str());
+        return ok;
+    }
+
+    // **********************************************************
+    void Flight_Recorder_Signal_Handler(int signal_number)
+    {
+        Dump_Flight_Recorder_To_File(flight_recorder_signal_filename);
+    }
+
+    // **********************************************************
+    void Flight_Recorder_Crash_Handler(int signal_number)
+    {
+        Dump_Flight_Recorder_To_File(flight_recorder_crash_filename);
+
+        // Let the default action (core dump, ...) happen.
+        signal(signal_number, SIG_DFL);
+        raise(signal_number);
+    }
+
+    // **********************************************************
+    void Dump_Flight_Recorder_On_Signal(const int signal_number, const std::string &filename)
+    /**
+     * Save the flight recorder to "filename" every time the process
+     * receives "signal_number" (for example SIGUSR1).
+     */
+    {
+        strncpy(flight_recorder_signal_filename, filename.c_str(), sizeof(flight_recorder_signal_filename)-1);
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = Flight_Recorder_Signal_Handler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        if (sigaction(signal_number, &action, NULL) != 0)
+            log("ERROR: Could not install flight recorder handler for signal %d!\n", signal_number);
+    }
+
+    // **********************************************************
+    void Dump_Flight_Recorder_On_Crash(const std::string &filename)
+    /**
+     * Save the flight recorder to "filename" if the program crashes
+     * (SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT).
+     */
+    {
+        strncpy(flight_recorder_crash_filename, filename.c_str(), sizeof(flight_recorder_crash_filename)-1);
+
+        const int crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+        for (size_t i = 0 ; i < sizeof(crash_signals)/sizeof(crash_signals[0]) ; i++)
+        {
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = Flight_Recorder_Crash_Handler;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESETHAND;
+            if (sigaction(crash_signals[i], &action, NULL) != 0)
+                log("ERROR: Could not install flight recorder handler for signal %d!\n", crash_signals[i]);
+        }
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,191 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstring> // memset(), memcpy()
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Precision of the histograms given to new timers (0: no histogram)
+    int histograms_precision = 0;
+
+    // Allowed range of Histogram's precision_bits
+    const int histogram_min_precision = 1;
+    const int histogram_max_precision = 16;
+
+    // **********************************************************
+    Histogram::Histogram(const int _precision_bits)
+    {
+        precision_bits = std::max(histogram_min_precision, std::min(histogram_max_precision, _precision_bits));
+        // Values below 2^precision_bits have their own bucket, then
+        // every power of two up to 2^63 has 2^(precision_bits-1) buckets.
+        nb_buckets = (66 - precision_bits) << (precision_bits - 1);
+        buckets = new uint64_t[nb_buckets];
+        Clear();
+    }
+
+    // **********************************************************
+    Histogram::Histogram(const Histogram &other)
+    {
+        precision_bits = other.precision_bits;
+        nb_buckets     = other.nb_buckets;
+        buckets        = new uint64_t[nb_buckets];
+        memcpy(buckets, other.buckets, nb_buckets*sizeof(uint64_t));
+        count          = other.count;
+        max            = other.max;
+    }
+
+    // **********************************************************
+    Histogram::~Histogram()
+    {
+        delete[] buckets;
+    }
+
+    // **********************************************************
+    uint64_t Histogram::Bucket_Lowest(const int index) const
+    {
+        const int nb_sub_buckets = 1 << precision_bits;
+        if (index < nb_sub_buckets)
+            return uint64_t(index);
+        const int shift = (index >> (precision_bits - 1)) - 1;
+        const uint64_t sub_bucket = uint64_t(index - (shift << (precision_bits - 1)));
+        return sub_bucket << shift;
+    }
+
+    // **********************************************************
+    uint64_t Histogram::Bucket_Highest(const int index) const
+    {
+        const int nb_sub_buckets = 1 << precision_bits;
+        if (index < nb_sub_buckets)
+            return uint64_t(index);
+        const int shift = (index >> (precision_bits - 1)) - 1;
+        const uint64_t sub_bucket = uint64_t(index - (shift << (precision_bits - 1)));
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    // **********************************************************
+    uint64_t Histogram::Percentile(const double percent) const
+    /**
+     * Return the value (in ticks) below which "percent" of the
+     * recorded values are: the highest value of the bucket reaching
+     * that rank, but never more than the largest recorded value.
+     */
+    {
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = uint64_t(std::ceil(percent / 100.0 * double(count)));
+        rank = std::max(uint64_t(1), std::min(count, rank));
+
+        uint64_t cumulative = 0;
+        for (int i = 0 ; i < nb_buckets ; i++)
+        {
+            cumulative += buckets[i];
+            if (cumulative >= rank)
+                return std::min(max, Bucket_Highest(i));
+        }
+        return max;
+    }
+
+    // **********************************************************
+    size_t Histogram::Footprint() const
+    /**
+     * Memory used by the histogram, in bytes.
+     */
+    {
+        return sizeof(Histogram) + size_t(nb_buckets)*sizeof(uint64_t);
+    }
+
+    // **********************************************************
+    void Histogram::Clear()
+    {
+        memset(buckets, 0, nb_buckets*sizeof(uint64_t));
+        count = 0;
+        max   = 0;
+    }
+
+    // **********************************************************
+    void Histogram::Merge(const Histogram &other)
+    /**
+     * Add "other"'s values to this histogram. If the precisions
+     * differ, "other"'s buckets are re-binned using their lowest value.
+     */
+    {
+        if (other.precision_bits == precision_bits)
+        {
+            for (int i = 0 ; i < nb_buckets ; i++)
+            {
+                buckets[i] += other.buckets[i];
+            }
+        }
+        else
+        {
+            for (int i = 0 ; i < other.nb_buckets ; i++)
+            {
+                if (other.buckets[i] != 0)
+                    buckets[Bucket_Index(other.Bucket_Lowest(i))] += other.buckets[i];
+            }
+        }
+        count += other.count;
+        max    = std::max(max, other.max);
+    }
+
+    // **********************************************************
+    bool Histogram::Save(const std::string &filename, const double seconds_per_tick) const
+    /**
+     * Save the non-empty buckets to "filename". Files saved with the
+     * same precision and clock source have the same buckets, so
+     * histograms of different runs can be merged by adding counts.
+     */
+    {
+        std::ofstream file(filename.c_str(), std::ios_base::out);
+        if (not file.is_open())
+        {
+            log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+            return false;
+        }
+
+        file << "# precision_bits = " << precision_bits << ", seconds_per_tick = " << seconds_per_tick << "\n";
+        file << "# Bucket, Lowest (seconds), Highest (seconds), Count\n";
+        for (int i = 0 ; i < nb_buckets ; i++)
+        {
+            if (buckets[i] == 0)
+                continue;
+            file << i << ", " << double(Bucket_Lowest(i)) * seconds_per_tick
+                      << ", " << double(Bucket_Highest(i)) * seconds_per_tick
+                      << ", " << buckets[i] << "\n";
+        }
+        return true;
+    }
+
+    // **********************************************************
+    void Enable_Histograms(const int precision_bits)
+    /**
+     * Give every timer created from now on a histogram of its
+     * Start()/Stop() durations (see Histogram). Each histogram uses
+     * (66 - precision_bits) * 2^(precision_bits-1) * 8 bytes
+     * (7.6 kB for the default of 5, i.e. 6.25% precision).
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        histograms_precision = std::max(histogram_min_precision, std::min(histogram_max_precision, precision_bits));
+    }
+
+    // **********************************************************
+    int Histograms_Precision()
+    {
+        return histograms_precision;
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,193 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>    // atexit()
+#include <cstring>    // memset()
+
+/**
+ * The interval report is a single CSV table with one row per timer
+ * active during an interval:
+ *
+ *   # Step begin, Step end, Time begin (s), Interval (s), Timer, Calls, Time (s), % of interval
+ *   0, 1000, 0, 12.5, "solver", 1000, 10.2, 81.6
+ *   0, 1000, 0, 12.5, "output", 10, 1.9, 15.2
+ *   1000, 2000, 12.5, 12.7, "solver", 1000, 10.4, 81.9
+ *   ...
+ *
+ * so its size grows with the number of intervals, not of calls.
+ * Times are measured from Enable_Interval_Report().
+ */
+
+namespace timing
+{
+    extern uint64_t timers_step;
+    void Initialize_Timers_Storage();
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Snapshot the timers every few steps or seconds
+    bool     interval_report_enabled = false;
+    FILE    *interval_report_file = NULL;
+    uint64_t interval_report_every_steps = 0;
+    double   interval_report_every_seconds = 0.0;
+    uint64_t interval_report_origin_ticks = 0;
+    // Start of the current interval
+    uint64_t interval_report_step = 0;
+    uint64_t interval_report_ticks = 0;
+    // Timers' totals at the start of the current interval, indexed by id
+    std::vector<Live_Stats_Timer> interval_report_previous;
+
+    // **********************************************************
+    void Enable_Interval_Report(const std::string &filename, const uint64_t every_steps, const double every_seconds)
+    /**
+     * Every "every_steps" steps or "every_seconds" seconds (0: never),
+     * whichever comes first, append to "filename" the calls and time
+     * of every timer since the previous interval (see above). Both
+     * are checked by TIMERS_SET_STEP(), so intervals end on a step.
+     * Only the calls made from now on are reported. The last
+     * (partial) interval is written by Close_Interval_Report(), at
+     * the program's exit.
+     */
+    {
+        Close_Interval_Report();
+
+        interval_report_file = fopen(filename.c_str(), "w");
+        if (interval_report_file == NULL)
+        {
+            log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+            return;
+        }
+        fprintf(interval_report_file, "# Step begin, Step end, Time begin (s), Interval (s), Timer, Calls, Time (s), %% of interval\n");
+        fflush(interval_report_file);
+
+        interval_report_every_steps   = every_steps;
+        interval_report_every_seconds = every_seconds;
+        interval_report_origin_ticks  = Clock_Monotonic::Get_Ticks();
+        interval_report_ticks         = interval_report_origin_ticks;
+        interval_report_step          = timers_step;
+
+        // Timers' totals so far are the baseline of the first interval.
+        interval_report_previous.clear();
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            Live_Stats_Timer current;
+            Get_Timer(id).Get_Live_Stats(current);
+            interval_report_previous.push_back(current);
+        }
+
+        // Timers must outlive the report: create their storage before
+        // registering the exit handler so it runs first.
+        Initialize_Timers_Storage();
+        static bool close_at_exit = false;
+        if (not close_at_exit)
+        {
+            atexit(Close_Interval_Report);
+            close_at_exit = true;
+        }
+
+        interval_report_enabled       = true;
+    }
+
+    // **********************************************************
+    bool Interval_Report_Enabled()
+    {
+        return interval_report_enabled;
+    }
+
+    // **********************************************************
+    void Interval_Report_Step(const uint64_t step)
+    /**
+     * Called by Set_Timers_Step(): end the interval if it is long
+     * enough.
+     */
+    {
+        if (not interval_report_enabled)
+            return;
+
+        const bool enough_steps = (interval_report_every_steps != 0
+                                   and step >= interval_report_step + interval_report_every_steps);
+        const bool enough_time = (interval_report_every_seconds > 0.0
+                                  and double(Clock_Monotonic::Get_Ticks() - interval_report_ticks) * Clock_Monotonic::Seconds_per_Tick()
+                                      >= interval_report_every_seconds);
+        if (enough_steps or enough_time)
+            Write_Interval_Report();
+    }
+
+    // **********************************************************
+    void Write_Interval_Report()
+    /**
+     * End the current interval: append its rows and start a new one.
+     */
+    {
+        if (not interval_report_enabled)
+            return;
+
+        const uint64_t now_ticks = Clock_Monotonic::Get_Ticks();
+        const double seconds_per_tick = Clock_Monotonic::Seconds_per_Tick();
+        const double begin    = double(interval_report_ticks - interval_report_origin_ticks) * seconds_per_tick;
+        const double interval = double(now_ticks - interval_report_ticks) * seconds_per_tick;
+
+        const uint32_t nb_timers = Nb_Timers();
+        if (interval_report_previous.size() < nb_timers)
+        {
+            Live_Stats_Timer zero;
+            memset(&zero, 0, sizeof(zero));
+            interval_report_previous.resize(nb_timers, zero);
+        }
+
+        // One write per interval
+        std::string rows;
+        char row[256];
+        for (Timer_Id id = 0 ; id < nb_timers ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            Live_Stats_Timer current;
+            timer.Get_Live_Stats(current);
+            Live_Stats_Timer &previous = interval_report_previous[id];
+            const uint64_t calls = current.calls - std::min(current.calls, previous.calls);
+            const double seconds = std::max(0.0, current.seconds - previous.seconds);
+            previous = current;
+            if (calls == 0 and seconds <= 0.0)
+                continue;
+
+            snprintf(row, sizeof(row), "%" PRIu64 ", %" PRIu64 ", %.6g, %.6g, \"",
+                     (uint64_t) interval_report_step, (uint64_t) timers_step, begin, interval);
+            rows += row;
+            rows += timer.Get_Name();
+            snprintf(row, sizeof(row), "\", %" PRIu64 ", %.6g, %.4g\n",
+                     (uint64_t) calls, seconds, (interval <= 0.0 ? 0.0 : seconds / interval * 100.0));
+            rows += row;
+        }
+        fwrite(rows.data(), 1, rows.length(), interval_report_file);
+        fflush(interval_report_file);
+
+        interval_report_step  = timers_step;
+        interval_report_ticks = now_ticks;
+    }
+
+    // **********************************************************
+    void Close_Interval_Report()
+    /**
+     * Write the last interval and close the report.
+     */
+    {
+        if (not interval_report_enabled)
+            return;
+
+        Write_Interval_Report();
+        fclose(interval_report_file);
+        interval_report_file    = NULL;
+        interval_report_enabled = false;
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
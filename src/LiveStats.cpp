@@ -0,0 +1,256 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>      // memset(), strncpy()
+#include <fcntl.h>      // open()
+#include <pthread.h>
+#include <sys/mman.h>   // mmap()
+#include <unistd.h>     // ftruncate(), getpid()
+
+namespace timing
+{
+    extern uint64_t timers_step;
+    extern double   last_timesteps_per_second;
+    void Initialize_Timers_Storage();
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Timers are published to a shared memory file by a background thread
+    bool                live_stats_enabled = false;
+    std::string         live_stats_filename;
+    Live_Stats_Header  *live_stats = NULL;
+    size_t              live_stats_size = 0;
+    uint64_t            live_stats_origin_ticks = 0;
+    pthread_t           live_stats_thread;
+    pthread_mutex_t     live_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t      live_stats_condition = PTHREAD_COND_INITIALIZER;
+    // Set to ask the publishing thread to finish
+    bool                live_stats_stop = false;
+
+    // **********************************************************
+    inline Live_Stats_Timer * Live_Stats_Timers()
+    {
+        return reinterpret_cast<Live_Stats_Timer *>(live_stats + 1);
+    }
+
+    // **********************************************************
+    void Timer_Base::Get_Live_Stats(Live_Stats_Timer &live) const
+    /**
+     * Timer's totals while it is in use by other threads. Only reads
+     * the timer (and its shards), so the values of a call being
+     * stopped concurrently might be missing.
+     */
+    {
+        uint64_t calls = 0, timed_calls = 0, ticks = 0, last_ticks = 0;
+        if (is_threaded)
+        {
+            for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+            {
+                const TimerShard *shard = cold->shards[i];
+                if (shard == NULL)
+                    continue;
+                calls       += shard->counter;
+                timed_calls += shard->statistics.count;
+                ticks       += shard->duration_ticks;
+                if (i == 0)
+                    last_ticks = shard->current_ticks;
+            }
+        }
+        else
+        {
+            calls       = counter;
+            timed_calls = statistics.count;
+            ticks       = duration_ticks;
+            last_ticks  = current_ticks;
+        }
+
+        live.calls        = calls;
+        live.timed_calls  = timed_calls;
+        live.seconds      = double(ticks) * Get_Seconds_per_Tick();
+        if (sampling_period != 0 and timed_calls != 0)
+            live.seconds *= double(calls) / double(timed_calls);
+        live.last_seconds = double(last_ticks) * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    void Write_Live_Stats()
+    /**
+     * Update the live statistics file, with live_stats_mutex held
+     * (the seqlock has a single writer). Never waits for its readers.
+     */
+    {
+        if (live_stats == NULL)
+            return;
+
+        const uint32_t nb_timers = std::min(uint32_t(Nb_Timers()), live_stats->capacity);
+
+        // Seqlock: odd while the content changes.
+        const uint64_t sequence = live_stats->sequence;
+        __atomic_store_n(&live_stats->sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        Live_Stats_Timer *timers = Live_Stats_Timers();
+        for (uint32_t id = live_stats->nb_timers ; id < nb_timers ; id++)
+        {
+            strncpy(timers[id].name, Get_Timer(id).Get_Name().c_str(), live_stats_name_length - 1);
+            timers[id].name[live_stats_name_length - 1] = '\0';
+        }
+        for (uint32_t id = 0 ; id < nb_timers ; id++)
+        {
+            Get_Timer(id).Get_Live_Stats(timers[id]);
+        }
+        live_stats->nb_timers            = nb_timers;
+        live_stats->step                 = timers_step;
+        live_stats->update_ns            = Clock_Realtime::Get_Ticks();
+        live_stats->elapsed_seconds      = double(Clock_Monotonic::Get_Ticks() - live_stats_origin_ticks) * Clock_Monotonic::Seconds_per_Tick();
+        __atomic_load(&last_timesteps_per_second, &live_stats->timesteps_per_second, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&live_stats->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+
+    // **********************************************************
+    void Publish_Live_Stats()
+    /**
+     * Update the live statistics file now, besides the background
+     * thread's periodic updates.
+     */
+    {
+        pthread_mutex_lock(&live_stats_mutex);
+        Write_Live_Stats();
+        pthread_mutex_unlock(&live_stats_mutex);
+    }
+
+    // **********************************************************
+    void * Live_Stats_Publisher(void *)
+    {
+        pthread_mutex_lock(&live_stats_mutex);
+        while (not live_stats_stop)
+        {
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            const double seconds = double(deadline.tv_nsec) * 1.0e-9 + live_stats->interval;
+            deadline.tv_sec  += time_t(seconds);
+            deadline.tv_nsec  = long((seconds - std::floor(seconds)) * 1.0e9);
+            pthread_cond_timedwait(&live_stats_condition, &live_stats_mutex, &deadline);
+            if (not live_stats_stop)
+                Write_Live_Stats();
+        }
+        pthread_mutex_unlock(&live_stats_mutex);
+        return NULL;
+    }
+
+    // **********************************************************
+    void Enable_Live_Stats(const double interval, const std::string &filename)
+    /**
+     * Publish every timer's number of calls and duration, and the
+     * current step, every "interval" seconds to "filename" (by
+     * default /dev/shm/timing.<pid>), from a background thread.
+     * Other processes (timing-top) map the file to follow the
+     * program; see Live_Stats_Header. The file is removed by
+     * Stop_Live_Stats(), at the program's exit.
+     */
+    {
+        if (live_stats_enabled)
+            return;
+
+        const int pid = int(getpid());
+        live_stats_filename = filename;
+        if (live_stats_filename.empty())
+            live_stats_filename = std::string(live_stats_prefix) + NumberToStr(pid);
+
+        const uint32_t capacity = TIMING_MAX_TIMERS;
+        live_stats_size = sizeof(Live_Stats_Header) + size_t(capacity) * sizeof(Live_Stats_Timer);
+
+        const int fd = open(live_stats_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 or ftruncate(fd, off_t(live_stats_size)) != 0)
+        {
+            log("ERROR: Could not create file \"%s\"!\n", live_stats_filename.c_str());
+            if (fd >= 0)
+                close(fd);
+            return;
+        }
+        void *memory = mmap(NULL, live_stats_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            log("ERROR: Could not map file \"%s\"!\n", live_stats_filename.c_str());
+            unlink(live_stats_filename.c_str());
+            return;
+        }
+
+        // The file is zero-filled: only the header needs to be set.
+        live_stats = static_cast<Live_Stats_Header *>(memory);
+        live_stats->version   = live_stats_version;
+        live_stats->capacity  = capacity;
+        live_stats->pid       = pid;
+        live_stats->interval  = std::max(1.0e-3, interval);
+        live_stats_origin_ticks = Clock_Monotonic::Get_Ticks();
+        // Readers check the magic last.
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(live_stats->magic, live_stats_magic, sizeof(live_stats_magic));
+
+        live_stats_stop = false;
+        if (pthread_create(&live_stats_thread, NULL, Live_Stats_Publisher, NULL) != 0)
+        {
+            log("ERROR: Could not start the live statistics thread!\n");
+            munmap(live_stats, live_stats_size);
+            unlink(live_stats_filename.c_str());
+            live_stats = NULL;
+            return;
+        }
+
+        // Timers must outlive the publishing thread: create their
+        // storage before registering the exit handler so it runs first.
+        Initialize_Timers_Storage();
+        static bool stop_at_exit = false;
+        if (not stop_at_exit)
+        {
+            atexit(Stop_Live_Stats);
+            stop_at_exit = true;
+        }
+
+        live_stats_enabled = true;
+    }
+
+    // **********************************************************
+    bool Live_Stats_Enabled()
+    {
+        return live_stats_enabled;
+    }
+
+    // **********************************************************
+    void Stop_Live_Stats()
+    /**
+     * Publish a last time, mark the file as finished and remove it.
+     * Readers having it mapped still see the last values.
+     */
+    {
+        if (not live_stats_enabled)
+            return;
+
+        pthread_mutex_lock(&live_stats_mutex);
+        live_stats_stop = true;
+        pthread_cond_signal(&live_stats_condition);
+        pthread_mutex_unlock(&live_stats_mutex);
+        pthread_join(live_stats_thread, NULL);
+
+        live_stats->is_finished = 1;
+        Publish_Live_Stats();
+        unlink(live_stats_filename.c_str());
+        munmap(live_stats, live_stats_size);
+        live_stats = NULL;
+        live_stats_enabled = false;
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,230 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstring> // strcmp()
+
+namespace timing
+{
+    extern Timer TimerTotal;
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // The calibration keeps the fastest of its batches of pairs.
+    const int overhead_nb_batches      = 20;
+    const int overhead_pairs_per_batch = 1000;
+
+    // **********************************************************
+    template <class ClockSource>
+    class Calibration_Timer : public Basic_Timer<ClockSource>
+    /**
+     * Timer outside the timers table, exercising the same inlined
+     * Start()/Stop() code as a program's timers.
+     */
+    {
+        public:
+            inline void Pair()
+            {
+                this->Fast_Start();
+                this->Fast_Stop();
+            }
+            inline uint64_t Duration_Ticks() const
+            {
+                return this->duration_ticks;
+            }
+    };
+
+    // **********************************************************
+    template <class ClockSource>
+    Timer_Overhead Measure_Overhead()
+    {
+        Calibration_Timer<ClockSource> timer;
+        timer.Clear();
+        if (Histograms_Precision() > 0)
+            timer.Enable_Histogram(Histograms_Precision());
+
+        Timer_Overhead overhead;
+        overhead.pair_seconds = 1.0;
+        overhead.bias_ticks   = 1.0e300;
+
+        // First batch warms up the caches and is discarded.
+        for (int batch = -1 ; batch < overhead_nb_batches ; batch++)
+        {
+            const uint64_t duration_before = timer.Duration_Ticks();
+            const uint64_t start_ns = Clock_Monotonic::Get_Ticks();
+            for (int i = 0 ; i < overhead_pairs_per_batch ; i++)
+            {
+                timer.Pair();
+            }
+            const uint64_t end_ns = Clock_Monotonic::Get_Ticks();
+            if (batch < 0)
+                continue;
+
+            const double pair_seconds = double(end_ns - start_ns) * nanosec_to_sec / double(overhead_pairs_per_batch);
+            const double bias_ticks   = double(timer.Duration_Ticks() - duration_before) / double(overhead_pairs_per_batch);
+            overhead.pair_seconds = std::min(overhead.pair_seconds, pair_seconds);
+            overhead.bias_ticks   = std::min(overhead.bias_ticks,   bias_ticks);
+        }
+
+        return overhead;
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    const Timer_Overhead & Calibrate_Overhead()
+    /**
+     * Measure, on the first call for a clock source, the cost of an
+     * empty Start()/Stop() pair (the fastest of several batches, with
+     * the histograms if enabled). Features going through _Start()/_Stop()
+     * (threaded mode, call path, output, ...) cost more than this.
+     */
+    {
+        static const Timer_Overhead overhead = Measure_Overhead<ClockSource>();
+        return overhead;
+    }
+
+    template const Timer_Overhead & Calibrate_Overhead<Clock_Monotonic>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_Monotonic_Raw>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_Monotonic_Coarse>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_Thread_CPU>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_Process_CPU>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_TSC>();
+    template const Timer_Overhead & Calibrate_Overhead<Clock_TSC_Fenced>();
+
+    // **********************************************************
+    void Timer_Base::Set_Overhead(const Timer_Overhead &overhead)
+    {
+        cold->overhead_pair_seconds = overhead.pair_seconds;
+        cold->overhead_bias_ticks   = overhead.bias_ticks;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Overhead_per_Call() const
+    /**
+     * Calibrated cost of one Start()/Stop() pair, in seconds.
+     */
+    {
+        return cold->overhead_pair_seconds;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Overhead_Bias_per_Call() const
+    /**
+     * Part of Get_Overhead_per_Call() included in each measured
+     * duration, in seconds.
+     */
+    {
+        return cold->overhead_bias_ticks * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Overhead() const
+    /**
+     * Time the program spent in this timer's Start()/Stop(), in seconds.
+     * Calls skipped by sampling don't read the clock and are neglected.
+     */
+    {
+        return double(Is_Sampled() ? statistics.count : counter) * cold->overhead_pair_seconds;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Corrected_Duration() const
+    /**
+     * Get_Estimated_Duration() without the part of the Start()/Stop()
+     * overhead measured by every call and, if the call path is
+     * tracked, without the Start()/Stop() of the timers nested inside
+     * this one, in seconds.
+     */
+    {
+        double corrected = Get_Estimated_Duration() - double(counter) * Get_Overhead_Bias_per_Call();
+        // Only the call path knows which timers ran inside this one.
+        if (Call_Path_Enabled())
+            corrected -= Call_Path_Nested_Overhead(this);
+        return std::max(0.0, corrected);
+    }
+
+    // **********************************************************
+    void Print_Overhead(const char *s, const size_t longest_length)
+    /**
+     * Print the calibrated Start()/Stop() cost of each clock source
+     * in use, then each timer's raw and overhead-corrected duration
+     * and the time spent in its Start()/Stop().
+     */
+    {
+        if (Nb_Timers() == 0)
+            return;
+
+        // Clock sources already reported (there are only a handful)
+        const char *clocks[16];
+        size_t nb_clocks = 0;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            const char *clock = timer.Get_Clock_Name();
+            bool reported = false;
+            for (size_t c = 0 ; c < nb_clocks and not reported ; c++)
+                reported = (strcmp(clocks[c], clock) == 0);
+            if (reported)
+                continue;
+            if (nb_clocks < sizeof(clocks) / sizeof(clocks[0]))
+                clocks[nb_clocks++] = clock;
+            Report("%sEmpty Start()/Stop() pair (%s): %.1f ns, of which %.1f ns are measured by the timer\n", s,
+                clock,
+                timer.Get_Overhead_per_Call() * sec_to_nanosec,
+                timer.Get_Overhead_Bias_per_Call() * sec_to_nanosec);
+        }
+        if (not Call_Path_Enabled())
+            Report("%sCorrected durations still include the Start()/Stop() of nested timers"
+                   " (enable the call path to remove it)\n", s);
+        Report("\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|    Raw     | Corrected  |       Overhead          |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  seconds   |  seconds   |  seconds   | %% of total |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|\n");
+
+        double total_overhead = 0.0;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            total_overhead += timer.Get_Overhead();
+
+            Report("%s| ", s);
+            Report_Padded(timer.Get_Name().c_str(), longest_length);
+            Report(" | %10.5g | %10.5g | %10.4g | %10.3f |\n", timer.Get_Estimated_Duration(),
+                                                            timer.Get_Corrected_Duration(),
+                                                            timer.Get_Overhead(),
+                                                            timer.Get_Overhead() / TimerTotal.Get_Duration() * 100.0);
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|\n");
+
+        Report("%s| ", s);
+        Report_Padded("Total", longest_length);
+        Report(" |            |            | %10.4g | %10.3f |\n", total_overhead,
+                                                           total_overhead / TimerTotal.Get_Duration() * 100.0);
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,237 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>    // memset()
+#include <new>        // Placement new
+#include <pthread.h>  // pthread_mutex_t
+
+namespace timing
+{
+    extern int nb_registered_threads;
+
+    // **********************************************************
+    class Parallel_Regions
+    /**
+     * Every parallel region, in creation order.
+     */
+    {
+        public:
+            std::vector<Parallel_Region *> regions;
+            pthread_mutex_t mutex;
+
+            Parallel_Regions()
+            {
+                pthread_mutex_init(&mutex, NULL);
+            }
+
+            ~Parallel_Regions()
+            {
+                Library_Allocations library;
+                for (size_t i = 0 ; i < regions.size() ; i++)
+                {
+                    regions[i]->~Parallel_Region();
+                    free(regions[i]);
+                }
+                pthread_mutex_destroy(&mutex);
+            }
+    };
+
+    // **********************************************************
+    Parallel_Regions & Parallel_Regions_List()
+    {
+        static Parallel_Regions list;
+        return list;
+    }
+
+    // **********************************************************
+    Parallel_Region::Parallel_Region(Timer &_timer)
+    {
+        timer = &_timer;
+        memset(slots, 0, sizeof(slots));
+        generation = 0;
+        Clear();
+    }
+
+    // **********************************************************
+    void Parallel_Region::Clear()
+    {
+        start_ticks     = 0;
+        nb_instances    = 0;
+        max_nb_threads  = 0;
+        thread_ticks    = 0;
+        busy_ticks      = 0;
+        busy_min_ticks  = 0;
+        busy_max_ticks  = 0;
+        busy_mean_ticks = 0.0;
+        wait_ticks      = 0;
+        lost_ticks      = 0;
+    }
+
+    // **********************************************************
+    void Parallel_Region::Start()
+    {
+        ++generation;
+        timer->Start();
+        start_ticks = Clock_Monotonic::Get_Ticks();
+    }
+
+    // **********************************************************
+    void Parallel_Region::Stop()
+    /**
+     * Close the current instance: add up the threads that entered
+     * it. Called once the threads are done (after the barrier).
+     */
+    {
+        const uint64_t end_ticks = Clock_Monotonic::Get_Ticks();
+        timer->Stop();
+
+        int nb_threads = 0;
+        uint64_t sum = 0, min = 0, max = 0, wait = 0;
+        const int nb_slots = std::min(int(__atomic_load_n(&nb_registered_threads, __ATOMIC_ACQUIRE)), int(TIMING_MAX_THREADS));
+        for (int i = 0 ; i < nb_slots ; i++)
+        {
+            const Parallel_Thread_Slot &slot = slots[i];
+            if (slot.generation != generation)
+                continue;
+            if (nb_threads == 0 or slot.busy_ticks < min)
+                min = slot.busy_ticks;
+            if (nb_threads == 0 or slot.busy_ticks > max)
+                max = slot.busy_ticks;
+            sum  += slot.busy_ticks;
+            wait += (end_ticks > slot.exit_ticks ? end_ticks - slot.exit_ticks : 0);
+            nb_threads++;
+        }
+        if (nb_threads == 0)
+            return;
+
+        nb_instances++;
+        max_nb_threads   = std::max(max_nb_threads, nb_threads);
+        thread_ticks    += uint64_t(nb_threads) * (end_ticks - start_ticks);
+        busy_ticks      += sum;
+        busy_min_ticks  += min;
+        busy_max_ticks  += max;
+        busy_mean_ticks += double(sum) / double(nb_threads);
+        wait_ticks      += wait;
+        lost_ticks      += uint64_t(nb_threads) * max - sum;
+    }
+
+    // **********************************************************
+    double Parallel_Region::Get_Efficiency() const
+    /**
+     * Fraction of the threads' time in the region spent working.
+     */
+    {
+        return (thread_ticks == 0 ? 1.0 : double(busy_ticks) / double(thread_ticks));
+    }
+
+    // **********************************************************
+    double Parallel_Region::Get_Imbalance() const
+    /**
+     * How much longer the most busy thread worked than the average
+     * thread, in percent.
+     */
+    {
+        return (busy_mean_ticks <= 0.0 ? 0.0 : (double(busy_max_ticks) / busy_mean_ticks - 1.0) * 100.0);
+    }
+
+    // **********************************************************
+    double Parallel_Region::Get_Lost_Core_Seconds() const
+    /**
+     * Core time the threads spent waiting for the most busy one.
+     */
+    {
+        return double(lost_ticks) * Clock_Monotonic::Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    Parallel_Region & New_Parallel_Region(const std::string &full_name, const std::string &strict_name)
+    /**
+     * Return the parallel region named "full_name", creating it (and
+     * its timer) on first use.
+     */
+    {
+        Library_Allocations library;
+        Timer &timer = New_Timer(full_name, strict_name);
+
+        Parallel_Regions &list = Parallel_Regions_List();
+        pthread_mutex_lock(&list.mutex);
+        Parallel_Region *region = NULL;
+        for (size_t i = 0 ; i < list.regions.size() ; i++)
+        {
+            if (list.regions[i]->timer == &timer)
+                region = list.regions[i];
+        }
+        if (region == NULL)
+        {
+            void *memory = NULL;
+            if (posix_memalign(&memory, TIMING_CACHE_LINE, sizeof(Parallel_Region)) != 0)
+            {
+                log("ERROR: Could not allocate parallel region \"%s\"!\n", full_name.c_str());
+                abort();
+            }
+            region = new (memory) Parallel_Region(timer);
+            list.regions.push_back(region);
+        }
+        pthread_mutex_unlock(&list.mutex);
+
+        return *region;
+    }
+
+    // **********************************************************
+    void Print_Parallel_Regions(const char *s, const size_t longest_length)
+    /**
+     * Print the per-thread busy time of each parallel region (summed
+     * over its instances), its load imbalance and its efficiency.
+     */
+    {
+        const std::vector<Parallel_Region *> &regions = Parallel_Regions_List().regions;
+        if (regions.empty())
+            return;
+
+        const double seconds_per_tick = Clock_Monotonic::Seconds_per_Tick();
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  Threads   | Thread busy time (seconds)           | Imbalance  |  Barrier   |    Lost    | Efficiency |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|            |    min     |    mean    |    max     |     %%      | wait (c.s) | core-sec.  |     %%      |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|------------|------------|\n");
+
+        for (size_t i = 0 ; i < regions.size() ; i++)
+        {
+            const Parallel_Region &region = *regions[i];
+
+            Report("%s| ", s);
+            Report_Padded(region.timer->Get_Name().c_str(), longest_length);
+            Report(" | %10d | %10.5g | %10.5g | %10.5g | %10.2f | %10.5g | %10.5g | %10.2f |\n",
+                region.max_nb_threads,
+                double(region.busy_min_ticks) * seconds_per_tick,
+                region.busy_mean_ticks * seconds_per_tick,
+                double(region.busy_max_ticks) * seconds_per_tick,
+                region.Get_Imbalance(),
+                double(region.wait_ticks) * seconds_per_tick,
+                region.Get_Lost_Core_Seconds(),
+                region.Get_Efficiency() * 100.0);
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|------------|------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,423 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstring>              // memset()
+#include <pthread.h>            // pthread_key_t
+#include <unistd.h>             // syscall(), read(), close()
+#include <sys/syscall.h>        // SYS_perf_event_open
+#include <sys/mman.h>           // mmap()
+#include <linux/perf_event.h>   // perf_event_attr, perf_event_mmap_page
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Read the calling thread's counter group at Start()/Stop()
+    bool perf_counters_enabled = false;
+    // Perf_Event mask requested by the program
+    uint32_t perf_requested_events = 0;
+    // Perf_Event mask that could be opened by the first thread
+    uint32_t perf_available_events = 0;
+    // True once the first thread opened its counters
+    bool perf_first_group_opened = false;
+
+    // **********************************************************
+    struct Perf_Event_Description
+    {
+        uint32_t    type;
+        uint64_t    config;
+        const char *name;
+    };
+
+    // Indexed by Perf_Event
+    const Perf_Event_Description perf_events[PERF_NB_EVENTS] =
+    {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,          "cycles"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,        "instructions"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,    "cache references"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,        "cache misses"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, "branches"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,       "branch misses"},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,         "page faults"},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,    "context switches"}
+    };
+
+    // **********************************************************
+    class PerfGroup
+    /**
+     * The calling thread's counters, opened as a single group (the
+     * first counter that could be opened leads it) so they are
+     * scheduled, and read, together.
+     */
+    {
+        public:
+            int fds[PERF_NB_EVENTS];                        // -1 if unavailable
+            int positions[PERF_NB_EVENTS];                  // In the group's read() buffer
+            perf_event_mmap_page *pages[PERF_NB_EVENTS];    // For rdpmc
+            int leader;
+            int nb_opened;
+            bool use_rdpmc;
+
+            PerfGroup();
+            ~PerfGroup();
+            void Read(uint64_t values[PERF_NB_EVENTS]) const;
+    };
+
+    // Calling thread's counter group (NULL until its first timer)
+    __thread PerfGroup *perf_group = NULL;
+    // Closes a thread's counters when it exits
+    pthread_key_t perf_group_key;
+    pthread_once_t perf_group_key_once = PTHREAD_ONCE_INIT;
+
+    // **********************************************************
+    long Perf_Event_Open(perf_event_attr *attributes, const int group_fd)
+    {
+        return syscall(SYS_perf_event_open, attributes, 0 /* this thread */, -1 /* any cpu */, group_fd, 0);
+    }
+
+    // **********************************************************
+    PerfGroup::PerfGroup()
+    {
+        leader    = -1;
+        nb_opened = 0;
+        use_rdpmc = true;
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+        {
+            fds[e]       = -1;
+            positions[e] = -1;
+            pages[e]     = NULL;
+            if ((perf_requested_events & (1u << e)) == 0)
+                continue;
+
+            perf_event_attr attributes;
+            memset(&attributes, 0, sizeof(attributes));
+            attributes.size           = sizeof(attributes);
+            attributes.type           = perf_events[e].type;
+            attributes.config         = perf_events[e].config;
+            attributes.read_format    = PERF_FORMAT_GROUP;
+            // Allowed without privileges (perf_event_paranoid <= 2)
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv     = 1;
+
+            const long fd = Perf_Event_Open(&attributes, leader);
+            if (fd < 0)
+                continue;
+            fds[e]       = int(fd);
+            positions[e] = nb_opened++;
+            if (leader < 0)
+                leader = int(fd);
+
+            // Hardware counters can be read from user space with rdpmc.
+            void *page = mmap(NULL, size_t(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, int(fd), 0);
+            if (page != MAP_FAILED)
+                pages[e] = static_cast<perf_event_mmap_page *>(page);
+            if (page == MAP_FAILED or not pages[e]->cap_user_rdpmc or pages[e]->index == 0)
+                use_rdpmc = false;
+        }
+#if not (defined(__x86_64__) || defined(__i386__))
+        use_rdpmc = false;
+#endif // #if not (defined(__x86_64__) || defined(__i386__))
+    }
+
+    // **********************************************************
+    PerfGroup::~PerfGroup()
+    {
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+        {
+            if (pages[e] != NULL)
+                munmap(pages[e], size_t(sysconf(_SC_PAGESIZE)));
+            if (fds[e] >= 0)
+                close(fds[e]);
+        }
+    }
+
+    // **********************************************************
+    inline uint64_t Read_With_Rdpmc(const volatile perf_event_mmap_page *page)
+    /**
+     * Read a counter without a system call: the kernel's offset
+     * plus the hardware counter, retried if the kernel updated the
+     * page meanwhile (see linux/perf_event.h).
+     */
+    {
+        uint64_t count = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t sequence;
+        do
+        {
+            sequence = page->lock;
+            __asm__ __volatile__("" ::: "memory");
+            const uint32_t index = page->index;
+            count = uint64_t(page->offset);
+            if (index != 0)
+            {
+                uint32_t low, high;
+                __asm__ __volatile__("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+                const int width = int(page->pmc_width);
+                int64_t pmc = int64_t((uint64_t(high) << 32) | uint64_t(low));
+                // Sign extend the counter's "width" bits
+                pmc <<= 64 - width;
+                pmc >>= 64 - width;
+                count += uint64_t(pmc);
+            }
+            __asm__ __volatile__("" ::: "memory");
+        } while (page->lock != sequence);
+#endif // #if defined(__x86_64__) || defined(__i386__)
+        return count;
+    }
+
+    // **********************************************************
+    void PerfGroup::Read(uint64_t values[PERF_NB_EVENTS]) const
+    {
+        if (use_rdpmc)
+        {
+            for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+            {
+                values[e] = (fds[e] < 0 ? 0 : Read_With_Rdpmc(pages[e]));
+            }
+            return;
+        }
+
+        // PERF_FORMAT_GROUP: number of counters, then their values
+        uint64_t buffer[1 + PERF_NB_EVENTS];
+        memset(buffer, 0, sizeof(buffer));
+        if (read(leader, buffer, sizeof(buffer)) < ssize_t(sizeof(uint64_t)))
+            buffer[0] = 0;
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+        {
+            values[e] = (positions[e] < 0 or uint64_t(positions[e]) >= buffer[0] ? 0 : buffer[1 + positions[e]]);
+        }
+    }
+
+    // **********************************************************
+    void Enable_Perf_Counters(const uint32_t events)
+    /**
+     * Count "events" (a mask of 1 << Perf_Event, every event by
+     * default) between every timer's Start() and Stop(), through a
+     * per-thread perf_event_open() counter group. Events that can't
+     * be opened (no hardware counters in a container or virtual
+     * machine, perf_event_paranoid too high) are left out. If only
+     * hardware events are requested (perf_hardware_events) and the
+     * kernel allows it, counters are read with rdpmc instead of a
+     * system call.
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        perf_requested_events = events & perf_all_events;
+        perf_counters_enabled = (perf_requested_events != 0);
+        if (perf_counters_enabled)
+            timers_features |= FEATURE_PERF_COUNTERS;
+        else
+            timers_features &= ~uint32_t(FEATURE_PERF_COUNTERS);
+    }
+
+    // **********************************************************
+    bool Perf_Counters_Enabled()
+    {
+        return perf_counters_enabled;
+    }
+
+    // **********************************************************
+    void Delete_Perf_Group(void *group)
+    {
+        Library_Allocations library;
+        delete static_cast<PerfGroup *>(group);
+    }
+
+    // **********************************************************
+    void Create_Perf_Group_Key()
+    {
+        pthread_key_create(&perf_group_key, Delete_Perf_Group);
+    }
+
+    // **********************************************************
+    PerfGroup * Local_Perf_Group()
+    {
+        PerfGroup *group = perf_group;
+        if (group == NULL)
+        {
+            Library_Allocations library;
+            group = new PerfGroup();
+            perf_group = group;
+            pthread_once(&perf_group_key_once, Create_Perf_Group_Key);
+            pthread_setspecific(perf_group_key, group);
+            if (not __sync_lock_test_and_set(&perf_first_group_opened, true))
+            {
+                for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+                {
+                    if (group->fds[e] >= 0)
+                        perf_available_events |= (1u << e);
+                }
+                if (group->nb_opened == 0)
+                {
+                    log("WARNING: No performance counter could be opened (see /proc/sys/kernel/perf_event_paranoid).\n");
+                    log("         Disabling performance counters.\n");
+                    Enable_Perf_Counters(0);
+                }
+            }
+        }
+        return group;
+    }
+
+    // **********************************************************
+    void Perf_Counters_Start(PerfCounts *&counts)
+    {
+        if (counts == NULL)
+        {
+            Library_Allocations library;
+            counts = new PerfCounts;
+            memset(counts, 0, sizeof(PerfCounts));
+        }
+        Local_Perf_Group()->Read(counts->start);
+    }
+
+    // **********************************************************
+    void Perf_Counters_Stop(PerfCounts *counts)
+    {
+        // The timer might have been started before counting was enabled.
+        if (counts == NULL)
+            return;
+
+        uint64_t values[PERF_NB_EVENTS];
+        Local_Perf_Group()->Read(values);
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+        {
+            counts->total[e] += values[e] - counts->start[e];
+        }
+        counts->nb_calls++;
+    }
+
+    // **********************************************************
+    bool Timer_Base::Get_Perf_Counts(uint64_t counts[PERF_NB_EVENTS], uint64_t &nb_calls) const
+    /**
+     * Sum of the timer's performance counters over its calls (and
+     * threads). Return false if none were counted.
+     */
+    {
+        memset(counts, 0, PERF_NB_EVENTS*sizeof(uint64_t));
+        nb_calls = 0;
+
+        const PerfCounts *all[1 + TIMING_MAX_THREADS];
+        int nb = 0;
+        all[nb++] = cold->perf;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                all[nb++] = cold->shards[i]->perf;
+        }
+        for (int i = 0 ; i < nb ; i++)
+        {
+            if (all[i] == NULL)
+                continue;
+            for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+            {
+                counts[e] += all[i]->total[e];
+            }
+            nb_calls += all[i]->nb_calls;
+        }
+        return (nb_calls != 0);
+    }
+
+    // **********************************************************
+    // Width of a formatted counter column, including its terminator
+    const size_t perf_column_size = 32;
+
+    // **********************************************************
+    const char * Perf_Ratio(char column[perf_column_size], const uint64_t counts[PERF_NB_EVENTS], const int numerator,
+                            const int denominator, const double factor)
+    /**
+     * "factor * numerator / denominator" formatted into "column", or
+     * "-" if either event is unavailable.
+     */
+    {
+        if ((perf_available_events & (1u << numerator)) == 0 or (perf_available_events & (1u << denominator)) == 0
+            or counts[denominator] == 0)
+            snprintf(column, perf_column_size, "%10s", "-");
+        else
+            snprintf(column, perf_column_size, "%10.4g", factor * double(counts[numerator]) / double(counts[denominator]));
+        return column;
+    }
+
+    // **********************************************************
+    const char * Perf_Per_Call(char column[perf_column_size], const uint64_t counts[PERF_NB_EVENTS], const int event,
+                               const uint64_t nb_calls)
+    {
+        if ((perf_available_events & (1u << event)) == 0)
+            snprintf(column, perf_column_size, "%10s", "-");
+        else
+            snprintf(column, perf_column_size, "%10.4g", double(counts[event]) / double(nb_calls));
+        return column;
+    }
+
+    // **********************************************************
+    void Print_Perf_Counters(const char *s, const size_t longest_length)
+    /**
+     * Print, for each timer, its instructions per cycle, cache and
+     * branch miss rates, and cycles, page faults and context switches
+     * per call. Unavailable events are shown as "-".
+     */
+    {
+        if (not perf_first_group_opened or perf_available_events == 0)
+            return;
+
+        bool any_unavailable = false;
+        for (int e = 0 ; e < PERF_NB_EVENTS ; e++)
+        {
+            if ((perf_requested_events & (1u << e)) == 0 or (perf_available_events & (1u << e)) != 0)
+                continue;
+            if (not any_unavailable)
+                Report("%sPerformance counters not available: %s", s, perf_events[e].name);
+            else
+                Report(", %s", perf_events[e].name);
+            any_unavailable = true;
+        }
+        if (any_unavailable)
+            Report("\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|    IPC     |   Cache    |   Branch   |                 Per call                |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|            |  misses %%  |  misses %%  |   cycles   |   faults   | ctx switch |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            uint64_t counts[PERF_NB_EVENTS];
+            uint64_t nb_calls;
+            if (not timer.Get_Perf_Counts(counts, nb_calls))
+                continue;
+
+            char columns[6][perf_column_size];
+            Report("%s| ", s);
+            Report_Padded(timer.Get_Name().c_str(), longest_length);
+            Report(" | %s | %s | %s | %s | %s | %s |\n",
+                Perf_Ratio(columns[0], counts, PERF_INSTRUCTIONS, PERF_CYCLES, 1.0),
+                Perf_Ratio(columns[1], counts, PERF_CACHE_MISSES, PERF_CACHE_REFERENCES, 100.0),
+                Perf_Ratio(columns[2], counts, PERF_BRANCH_MISSES, PERF_BRANCHES, 100.0),
+                Perf_Per_Call(columns[3], counts, PERF_CYCLES, nb_calls),
+                Perf_Per_Call(columns[4], counts, PERF_PAGE_FAULTS, nb_calls),
+                Perf_Per_Call(columns[5], counts, PERF_CONTEXT_SWITCHES, nb_calls));
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,353 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>  // realloc(), free()
+#include <cstring>  // memcpy(), memset()
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Buffer receiving Report()'s text (NULL: printed directly)
+    Report_Buffer *report_buffer = NULL;
+
+    // **********************************************************
+    char * Unsigned_To_Chars(char *first, char *last, uint64_t value)
+    /**
+     * Write "value" in decimal in [first, last) (no terminating
+     * '\0'), like C++17's std::to_chars(). Return the end of the
+     * digits, or NULL if they don't fit.
+     */
+    {
+        char digits[20];
+        int nb = 0;
+        do
+        {
+            digits[nb++] = char('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        if (last - first < nb)
+            return NULL;
+        while (nb > 0)
+            *first++ = digits[--nb];
+        return first;
+    }
+
+    // **********************************************************
+    std::string Integer_To_Str(const uint64_t magnitude, const bool is_negative, const int width, const char fill)
+    /**
+     * NumberToStr() of an integer: same padding as a stream (sign
+     * before the fill characters).
+     */
+    {
+        char digits[24];
+        char *end = Unsigned_To_Chars(digits, digits + sizeof(digits), magnitude);
+        const size_t nb_digits = size_t(end - digits);
+        const size_t nb_chars  = nb_digits + (is_negative ? 1 : 0);
+        const size_t padding   = (size_t(std::max(0, width)) > nb_chars ? size_t(width) - nb_chars : 0);
+
+        std::string number;
+        number.reserve(nb_chars + padding);
+        number.append(padding, fill);
+        if (is_negative)
+            number.push_back('-');
+        number.append(digits, nb_digits);
+        return number;
+    }
+
+    // **********************************************************
+    std::string NumberToStr(const int integer, const int width, const char fill)
+    {
+        return NumberToStr(long(integer), width, fill);
+    }
+
+    // **********************************************************
+    std::string NumberToStr(const unsigned int integer, const int width, const char fill)
+    {
+        return Integer_To_Str(uint64_t(integer), false, width, fill);
+    }
+
+    // **********************************************************
+    std::string NumberToStr(const long integer, const int width, const char fill)
+    {
+        // Negate as unsigned: -LONG_MIN overflows a long.
+        const uint64_t magnitude = (integer < 0 ? uint64_t(0) - uint64_t(integer) : uint64_t(integer));
+        return Integer_To_Str(magnitude, integer < 0, width, fill);
+    }
+
+    // **********************************************************
+    std::string NumberToStr(const unsigned long integer, const int width, const char fill)
+    {
+        return Integer_To_Str(uint64_t(integer), false, width, fill);
+    }
+
+    // **********************************************************
+    Report_Buffer::Report_Buffer()
+    {
+        data         = NULL;
+        capacity     = 0;
+        length       = 0;
+        is_owner     = true;
+        is_truncated = false;
+    }
+
+    // **********************************************************
+    Report_Buffer::Report_Buffer(char *buffer, const size_t size)
+    /**
+     * Format into the caller's "buffer" of "size" bytes. The text is
+     * always terminated by '\0'.
+     */
+    {
+        data         = buffer;
+        capacity     = size;
+        length       = 0;
+        is_owner     = false;
+        is_truncated = false;
+        if (capacity != 0)
+            data[0] = '\0';
+    }
+
+    // **********************************************************
+    Report_Buffer::~Report_Buffer()
+    {
+        Library_Allocations library;
+        if (is_owner)
+            free(data);
+    }
+
+    // **********************************************************
+    void Report_Buffer::Clear()
+    {
+        length       = 0;
+        is_truncated = false;
+        if (capacity != 0)
+            data[0] = '\0';
+    }
+
+    // **********************************************************
+    size_t Report_Buffer::Available(const size_t wanted)
+    /**
+     * Make room for "wanted" characters (plus the '\0') if possible.
+     * Return the number of characters that fit.
+     */
+    {
+        if (is_owner and length + wanted + 1 > capacity)
+        {
+            const size_t new_capacity = std::max(2*capacity, std::max(size_t(4096), length + wanted + 1));
+            Library_Allocations library;
+            char *new_data = static_cast<char *>(realloc(data, new_capacity));
+            if (new_data != NULL)
+            {
+                data     = new_data;
+                capacity = new_capacity;
+            }
+        }
+        if (capacity == 0)
+            return 0;
+        return std::min(wanted, capacity - 1 - length);
+    }
+
+    // **********************************************************
+    void Report_Buffer::Append(const char *text, const size_t n)
+    {
+        const size_t nb = Available(n);
+        if (nb < n)
+            is_truncated = true;
+        if (nb == 0)
+            return;
+        memcpy(data + length, text, nb);
+        length += nb;
+        data[length] = '\0';
+    }
+
+    // **********************************************************
+    void Report_Buffer::Append(const char *text)
+    {
+        Append(text, strlen(text));
+    }
+
+    // **********************************************************
+    void Report_Buffer::Append(const std::string &text)
+    {
+        Append(text.data(), text.length());
+    }
+
+    // **********************************************************
+    void Report_Buffer::Repeat(const char c, const size_t n)
+    {
+        const size_t nb = Available(n);
+        if (nb < n)
+            is_truncated = true;
+        if (nb == 0)
+            return;
+        memset(data + length, c, nb);
+        length += nb;
+        data[length] = '\0';
+    }
+
+    // **********************************************************
+    void Report_Buffer::Append_Unsigned(const uint64_t value, const int width, const char fill)
+    {
+        char digits[20];
+        const size_t nb_digits = size_t(Unsigned_To_Chars(digits, digits + sizeof(digits), value) - digits);
+        if (size_t(std::max(0, width)) > nb_digits)
+            Repeat(fill, size_t(width) - nb_digits);
+        Append(digits, nb_digits);
+    }
+
+    // **********************************************************
+    void Report_Buffer::Append_Duration(const double seconds)
+    /**
+     * Append "seconds" like Duration_Human_Readable() ("1d02h03m04s").
+     */
+    {
+        char duration[32];
+        Append(duration, Format_Duration(seconds, duration, sizeof(duration)));
+    }
+
+    // **********************************************************
+    void Report_Buffer::Printf(const char *format, ...)
+    {
+        va_list arguments;
+        va_start(arguments, format);
+        VPrintf(format, arguments);
+        va_end(arguments);
+    }
+
+    // **********************************************************
+    void Report_Buffer::VPrintf(const char *format, va_list arguments)
+    /**
+     * Format directly at the end of the text. Only formats twice when
+     * an owned buffer has to grow.
+     */
+    {
+        va_list copy;
+        __builtin_va_copy(copy, arguments);
+        const size_t room = (capacity > length ? capacity - length : 0);
+        const int nb = vsnprintf(data + length, room, format, copy);
+        va_end(copy);
+        if (nb < 0)
+            return;
+
+        if (size_t(nb) < room)
+        {
+            length += size_t(nb);
+            return;
+        }
+
+        const size_t nb_fitting = Available(size_t(nb));
+        if (nb_fitting == size_t(nb))
+        {
+            vsnprintf(data + length, capacity - length, format, arguments);
+            length += size_t(nb);
+        }
+        else
+        {
+            // vsnprintf() already wrote as much as fitted.
+            is_truncated = true;
+            length += nb_fitting;
+        }
+    }
+
+    // **********************************************************
+    void Report_Buffer::Print() const
+    /**
+     * Print the text with a single write.
+     */
+    {
+        if (length == 0)
+            return;
+#ifdef USE_STDCOUT
+        log("%s", data);
+#else // #ifdef USE_STDCOUT
+        fflush(stdout);
+        fwrite(data, 1, length, stdout);
+        fflush(stdout);
+#endif // #ifdef USE_STDCOUT
+    }
+
+    // **********************************************************
+    Report_Buffer * Set_Report_Buffer(Report_Buffer *buffer)
+    /**
+     * Send Report()'s text to "buffer" (NULL: print it directly).
+     * Return the previous buffer.
+     */
+    {
+        Report_Buffer *previous = report_buffer;
+        report_buffer = buffer;
+        return previous;
+    }
+
+    // **********************************************************
+    void Report(const char *format, ...)
+    /**
+     * printf() of the reports: appends to the current report buffer,
+     * if any (see Set_Report_Buffer()).
+     */
+    {
+        va_list arguments;
+        va_start(arguments, format);
+        if (report_buffer != NULL)
+        {
+            report_buffer->VPrintf(format, arguments);
+        }
+        else
+        {
+#ifdef USE_STDCOUT
+            char line[1024];
+            vsnprintf(line, sizeof(line), format, arguments);
+            log("%s", line);
+#else // #ifdef USE_STDCOUT
+            vprintf(format, arguments);
+#endif // #ifdef USE_STDCOUT
+        }
+        va_end(arguments);
+    }
+
+    // **********************************************************
+    void Report_Repeat(const char c, const size_t n)
+    /**
+     * Report() "n" times the character "c".
+     */
+    {
+        if (report_buffer != NULL)
+        {
+            report_buffer->Repeat(c, n);
+            return;
+        }
+
+        char line[128];
+        memset(line, c, sizeof(line) - 1);
+        for (size_t done = 0 ; done < n ; done += sizeof(line) - 1)
+        {
+            const size_t nb = std::min(n - done, sizeof(line) - 1);
+            line[nb] = '\0';
+            Report("%s", line);
+        }
+    }
+
+    // **********************************************************
+    void Report_Padded(const char *text, const size_t width)
+    /**
+     * Report() "text" followed by spaces up to "width" characters
+     * (a table cell).
+     */
+    {
+        const size_t length = strlen(text);
+        Report("%s", text);
+        if (length < width)
+            Report_Repeat(' ', width - length);
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,226 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstring>          // memset()
+#include <sys/resource.h>   // getrusage()
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Measure one call in "timers_usage_period" of the timers created from now on (0: none)
+    uint32_t timers_usage_period = 0;
+
+    // **********************************************************
+    inline uint64_t Microseconds(const timeval &t)
+    {
+        return uint64_t(t.tv_sec) * 1000000 + uint64_t(t.tv_usec);
+    }
+
+    // **********************************************************
+    void Read_Resource_Usage(uint64_t values[USAGE_NB_FIELDS])
+    /**
+     * Calling thread's resource usage. The maximum resident set size
+     * is the process' (Linux doesn't track it per thread).
+     */
+    {
+        rusage usage;
+        memset(&usage, 0, sizeof(usage));
+        getrusage(RUSAGE_THREAD, &usage);
+        values[USAGE_WALL_NS]              = Clock_Monotonic::Get_Ticks();
+        values[USAGE_USER_US]              = Microseconds(usage.ru_utime);
+        values[USAGE_SYSTEM_US]            = Microseconds(usage.ru_stime);
+        values[USAGE_MINOR_FAULTS]         = uint64_t(usage.ru_minflt);
+        values[USAGE_MAJOR_FAULTS]         = uint64_t(usage.ru_majflt);
+        values[USAGE_VOLUNTARY_SWITCHES]   = uint64_t(usage.ru_nvcsw);
+        values[USAGE_INVOLUNTARY_SWITCHES] = uint64_t(usage.ru_nivcsw);
+        values[USAGE_MAXRSS_KB]            = uint64_t(usage.ru_maxrss);
+    }
+
+    // **********************************************************
+    void Enable_Timers_Resource_Usage(const uint32_t period)
+    /**
+     * Measure the resource usage (getrusage(RUSAGE_THREAD): CPU time,
+     * page faults, context switches, peak resident set size) between
+     * Start() and Stop() of one call in "period" of every timer
+     * created from now on. Each measure costs two system calls; a
+     * single timer can be measured with Enable_Resource_Usage().
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        timers_usage_period = period;
+    }
+
+    // **********************************************************
+    uint32_t Timers_Resource_Usage_Period()
+    {
+        return timers_usage_period;
+    }
+
+    // **********************************************************
+    void Timer_Base::Enable_Resource_Usage(const uint32_t period)
+    /**
+     * Measure the resource usage of one timed call in "period" (see
+     * Enable_Timers_Resource_Usage()).
+     */
+    {
+        cold->usage_period = std::max(uint32_t(1), period);
+        needs_slow_path    = true;
+    }
+
+    // **********************************************************
+    void Timer_Base::Disable_Resource_Usage()
+    {
+        cold->usage_period = 0;
+        needs_slow_path    = false;
+    }
+
+    // **********************************************************
+    void Resource_Usage_Start(ResourceUsage *&usage, const uint32_t period)
+    {
+        if (usage == NULL)
+        {
+            Library_Allocations library;
+            usage = new ResourceUsage;
+            memset(usage, 0, sizeof(ResourceUsage));
+            usage->countdown = 1;
+        }
+        if (usage->period != period)
+        {
+            usage->period    = period;
+            usage->countdown = std::min(usage->countdown, period);
+        }
+
+        usage->is_measured = (--usage->countdown == 0);
+        if (not usage->is_measured)
+            return;
+        usage->countdown = usage->period;
+        Read_Resource_Usage(usage->start);
+    }
+
+    // **********************************************************
+    void Resource_Usage_Stop(ResourceUsage *usage)
+    {
+        if (not usage->is_measured)
+            return;
+        usage->is_measured = false;
+
+        uint64_t values[USAGE_NB_FIELDS];
+        Read_Resource_Usage(values);
+        for (int f = 0 ; f < USAGE_NB_FIELDS ; f++)
+        {
+            // The peak resident set size only grows.
+            usage->total[f] += (values[f] > usage->start[f] ? values[f] - usage->start[f] : 0);
+        }
+        usage->nb_calls++;
+    }
+
+    // **********************************************************
+    bool Timer_Base::Get_Resource_Usage(uint64_t usage[USAGE_NB_FIELDS], uint64_t &nb_calls) const
+    /**
+     * Sum of the timer's resource usage over its measured calls (and
+     * threads). Return false if none were measured.
+     */
+    {
+        memset(usage, 0, USAGE_NB_FIELDS*sizeof(uint64_t));
+        nb_calls = 0;
+
+        const ResourceUsage *all[1 + TIMING_MAX_THREADS];
+        int nb = 0;
+        all[nb++] = cold->usage;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                all[nb++] = cold->shards[i]->usage;
+        }
+        for (int i = 0 ; i < nb ; i++)
+        {
+            if (all[i] == NULL)
+                continue;
+            for (int f = 0 ; f < USAGE_NB_FIELDS ; f++)
+            {
+                usage[f] += all[i]->total[f];
+            }
+            nb_calls += all[i]->nb_calls;
+        }
+        return (nb_calls != 0);
+    }
+
+    // **********************************************************
+    void Print_Resource_Usage(const char *s, const size_t longest_length)
+    /**
+     * Print, for each measured timer, its CPU time (user + system)
+     * over its wall time and its resource usage per measured call.
+     * A low CPU/wall ratio points at a region waiting: for I/O or a
+     * lock if its voluntary context switches are high, preempted by
+     * other threads (oversubscription) if its involuntary ones are.
+     * CPU times have the kernel's accounting resolution, so the ratio
+     * of calls much shorter than a scheduler tick is only meaningful
+     * over many calls.
+     */
+    {
+        bool has_usage = false;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            uint64_t usage[USAGE_NB_FIELDS];
+            uint64_t nb_calls;
+            if (Get_Timer(id).Get_Resource_Usage(usage, nb_calls))
+                has_usage = true;
+        }
+        if (not has_usage)
+            return;
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  Measured  |  CPU/wall  |                                 Per call                                |  Peak RSS  |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|   calls    |     %%      |  user (s)  | system (s) |  minor pf  |  major pf  |  vol. cs   | invol. cs  | growth (kB)|\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|------------|------------|------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            uint64_t usage[USAGE_NB_FIELDS];
+            uint64_t nb_calls;
+            if (not timer.Get_Resource_Usage(usage, nb_calls))
+                continue;
+
+            const double calls   = double(nb_calls);
+            const double cpu_us  = double(usage[USAGE_USER_US] + usage[USAGE_SYSTEM_US]);
+            const double wall_us = double(usage[USAGE_WALL_NS]) * Clock_Monotonic::Seconds_per_Tick() * 1.0e6;
+
+            Report("%s| ", s);
+            Report_Padded(timer.Get_Name().c_str(), longest_length);
+            Report(" | %10" PRIu64 " | %10.2f | %10.4g | %10.4g | %10.4g | %10.4g | %10.4g | %10.4g | %10" PRIu64 " |\n",
+                (uint64_t) nb_calls,
+                (wall_us <= 0.0 ? 0.0 : cpu_us / wall_us * 100.0),
+                double(usage[USAGE_USER_US]) * 1.0e-6 / calls,
+                double(usage[USAGE_SYSTEM_US]) * 1.0e-6 / calls,
+                double(usage[USAGE_MINOR_FAULTS]) / calls,
+                double(usage[USAGE_MAJOR_FAULTS]) / calls,
+                double(usage[USAGE_VOLUNTARY_SWITCHES]) / calls,
+                double(usage[USAGE_INVOLUNTARY_SWITCHES]) / calls,
+                (uint64_t) usage[USAGE_MAXRSS_KB]);
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|------------|------------|------------|------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,154 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // State of each thread's xorshift generator (never 0)
+    __thread uint64_t sampling_random_state = 0;
+
+    // Two-sided 95% quantile of the normal distribution
+    const double sampling_confidence_z = 1.96;
+
+    // **********************************************************
+    uint32_t Next_Sampling_Countdown(const uint32_t period, const bool randomized)
+    /**
+     * Number of calls until the next timed one: always "period", or
+     * uniformly drawn in [1, 2*period-1] (mean "period") so that the
+     * sampling cannot lock onto a periodic pattern of the program.
+     */
+    {
+        if (not randomized or period <= 1)
+            return period;
+
+        uint64_t x = sampling_random_state;
+        if (x == 0)
+            x = (uint64_t(0x9E3779B9u) << 32) | uint64_t(Thread_Index() + 1);
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sampling_random_state = x;
+        return 1 + uint32_t(x % uint64_t(2*period - 1));
+    }
+
+    // **********************************************************
+    void Timer_Base::Set_Sampling(const uint32_t period, const bool randomized)
+    /**
+     * Only measure one Start()/Stop() in "period" (every call if 0
+     * or 1), on a fixed stride or at random. Every call is still
+     * counted so the total duration can be extrapolated.
+     */
+    {
+        sampling_period     = (period <= 1 ? 0 : period);
+        sampling_randomized = randomized;
+        sampling_countdown  = 1;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                cold->shards[i]->sampling_countdown = 1;
+        }
+    }
+
+    // **********************************************************
+    uint32_t Timer_Base::Get_Sampling_Period() const
+    {
+        return sampling_period;
+    }
+
+    // **********************************************************
+    bool Timer_Base::Is_Sampled() const
+    {
+        return sampling_period != 0;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Estimated_Duration() const
+    /**
+     * Total duration of every call, in seconds: the measured duration
+     * scaled by the number of calls over the number of timed calls.
+     */
+    {
+        if (not Is_Sampled() or statistics.count == 0)
+            return Get_Duration();
+        return Get_Duration() * double(counter) / double(statistics.count);
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Estimated_Duration_Error() const
+    /**
+     * Half-width of the 95% confidence interval of
+     * Get_Estimated_Duration(), in seconds. The timed calls are taken
+     * as a random sample of all calls (hence the finite population
+     * correction); 0 if the timer is not sampled.
+     */
+    {
+        const double N = double(counter);
+        const double n = double(statistics.count);
+        if (not Is_Sampled() or n < 2.0 or N <= n)
+            return 0.0;
+        return sampling_confidence_z * N * Get_Standard_Deviation() / std::sqrt(n) * std::sqrt((N - n) / (N - 1.0));
+    }
+
+    // **********************************************************
+    void Print_Sampled(const char *s, const size_t longest_length)
+    /**
+     * Print what the extrapolated totals of sampled timers are
+     * based on.
+     */
+    {
+        bool has_sampled = false;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            if (Get_Timer(id).Is_Sampled())
+                has_sampled = true;
+        }
+        if (not has_sampled)
+            return;
+
+        Report("%s* Sampled timer: its duration is extrapolated from a fraction of its calls.\n\n", s);
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  Sampling  |   Timed    |  Measured  | Estimated  |    95%%     |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|   period   |   calls    |  seconds   |  seconds   | confidence |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            if (not timer.Is_Sampled())
+                continue;
+
+            const std::string &timer_name = timer.Get_Name();
+            Report("%s| %s *", s, timer_name.c_str());
+            Report_Repeat(' ', longest_length - std::min(longest_length, timer_name.length() + 2));
+            Report(" | %10u | %10" PRIu64 " | %10.5g | %10.5g | +-%8.3g |\n", (unsigned int) timer.Get_Sampling_Period(),
+                                                                          (uint64_t) timer.Get_Statistics().count,
+                                                                          timer.Get_Duration(),
+                                                                          timer.Get_Estimated_Duration(),
+                                                                          timer.Get_Estimated_Duration_Error());
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|\n\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,60 @@
+#include "Timing.hpp"
+
+namespace timing
+{
+    // **********************************************************
+    DurationStatistics::DurationStatistics()
+    {
+        Clear();
+    }
+
+    // **********************************************************
+    void DurationStatistics::Clear()
+    {
+        count = 0;
+        min   = 0;
+        max   = 0;
+        mean  = 0.0;
+        m2    = 0.0;
+    }
+
+    // **********************************************************
+    void DurationStatistics::Merge(const DurationStatistics &other)
+    /**
+     * Combine with the statistics of another set of durations
+     * (Chan et al. pairwise update).
+     */
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        const double n_a   = double(count);
+        const double n_b   = double(other.count);
+        const double n     = n_a + n_b;
+        const double delta = other.mean - mean;
+
+        min    = std::min(min, other.min);
+        max    = std::max(max, other.max);
+        mean  += delta * n_b / n;
+        m2    += other.m2 + delta * delta * n_a * n_b / n;
+        count += other.count;
+    }
+
+    // **********************************************************
+    double DurationStatistics::Variance() const
+    /**
+     * Sample variance, in ticks squared.
+     */
+    {
+        if (count < 2)
+            return 0.0;
+        return m2 / double(count - 1);
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -10,13 +10,14 @@
 #define log printf
 #endif // #ifdef USE_STDCOUT
 
+#include <cstddef> // offsetof()
 #include <cstdlib>
 #include <cstring> // memset()
+#include <iomanip> // std::setw()
+#include <new>     // Placement new
 
 namespace timing
 {
-    extern std::map<std::string, Timer> TimersMap;
-
     // This is a timer that keeps track of the total running time.
     // The constructor starts it automatically.
     // This is needed for ETA calculation.
@@ -24,194 +25,488 @@ namespace timing
     // Flags to enable/disable timing information output
     extern std::string output_folder;  // Directory where to save timing information
     extern uint64_t    timers_step;    // Current time step
+    // Record Start()/Stop() pairs in per-thread call-path trees
+    extern bool        call_path_enabled;
+    // Record Start()/Stop() pairs in per-thread flight recorder rings
+    extern bool        flight_recorder_enabled;
+    extern bool        trace_enabled;
+    extern bool        perf_counters_enabled;
+    extern bool        allocations_enabled;
+    // Timers output is written by a background thread
+    extern bool        asynchronous_output_enabled;
 
     // **********************************************************
-    void Timer::Set_Name(const std::string &_full_name, const std::string &_strict_name)
+    void Timer_Base::Set_Name(const std::string &_full_name, const std::string &_strict_name)
     {
-        name = _full_name;
+        cold->name = _full_name;
 
         // Only set the filename once. Since Set_Name() can be called multiple
         // times for the same _full_name but with a different _strict_name,
         // only set the filename once.
-        if (output_filename == "")
-            output_filename = output_folder + "/" + _strict_name + ".csv";
+        if (cold->output_filename == "")
+            cold->output_filename = output_folder + "/" + _strict_name + ".csv";
+    }
+
+    // **********************************************************
+    const std::string & Timer_Base::Get_Name() const
+    {
+        return cold->name;
+    }
+
+    // **********************************************************
+    const std::string & Timer_Base::Get_Output_Filename() const
+    {
+        return cold->output_filename;
     }
 
     // **********************************************************
-    Timer::Timer()
+    Timer_Base::Timer_Base()
     /**
      * Default constructor.
      */
     {
+        // Start()/Stop() must only touch one line of hot state: the
+        // statistics, aligned on the next line, must directly follow it.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+        typedef char hot_state_fits_in_one_cache_line
+            [offsetof(Timer_Base, statistics) - offsetof(Timer_Base, start_ticks) == TIMING_CACHE_LINE ? 1 : -1]
+            __attribute__((unused));
+#pragma GCC diagnostic pop
+
+        Library_Allocations library;
+        cold        = new TimerCold();
+        is_threaded = false;
+        id          = 0xFFFFFFFF;
+        histogram   = NULL;
+        sampling_period     = 0;
+        sampling_randomized = false;
+        needs_slow_path     = false;
         Clear();
-        Start();
     }
 
     // **********************************************************
-    Timer::Timer(const Timer &other)
+    Timer_Base::Timer_Base(const Timer_Base &other)
     /**
      * Copy constructor. Required so that Timer class can contain
      * an std::ofstream (output_file).
      */
     {
+        Library_Allocations library;
+        cold            = new TimerCold();
         is_started      = other.is_started;
         counter         = other.counter;
-        start           = other.start;
-        end             = other.end;
-        duration        = other.duration;
-        current_duration= other.current_duration;
-        name            = other.name;
-        output_filename = other.output_filename;
-        output_has_been_performed = false;
+        start_ticks     = other.start_ticks;
+        end_ticks       = other.end_ticks;
+        duration_ticks  = other.duration_ticks;
+        current_ticks   = other.current_ticks;
+        cold->name            = other.cold->name;
+        cold->output_filename = other.cold->output_filename;
+        cold->output_dropped  = other.cold->output_dropped;
+        cold->overhead_pair_seconds = other.cold->overhead_pair_seconds;
+        cold->overhead_bias_ticks   = other.cold->overhead_bias_ticks;
+        cold->usage_period          = other.cold->usage_period;
+        // Shards belong to a single timer; a copy starts without any.
+        is_threaded     = other.is_threaded;
+        id              = other.id;
+        is_timed        = other.is_timed;
+        sampling_period     = other.sampling_period;
+        sampling_countdown  = other.sampling_countdown;
+        sampling_randomized = other.sampling_randomized;
+        needs_slow_path     = other.needs_slow_path;
+        statistics      = other.statistics;
+        histogram       = (other.histogram == NULL ? NULL : new Histogram(*other.histogram));
+    }
+
+    // **********************************************************
+    Timer_Base::~Timer_Base()
+    {
+        Library_Allocations library;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+            {
+                cold->shards[i]->~TimerShard();
+                free(cold->shards[i]);
+            }
+        }
+        delete histogram;
+        delete cold;
+    }
+
+    // **********************************************************
+    TimerShard & Timer_Base::Local_Shard(const int thread_index)
+    /**
+     * Return the calling thread's shard, allocating it on first use.
+     * Only the calling thread ever writes to its slot, so no
+     * synchronization is needed.
+     */
+    {
+        TimerShard *shard = cold->shards[thread_index];
+        if (shard == NULL or (histogram != NULL and shard->histogram == NULL))
+            return New_Local_Shard(thread_index);
+        return *shard;
+    }
+
+    // **********************************************************
+    TimerShard & Timer_Base::New_Local_Shard(const int thread_index)
+    /**
+     * Allocate the calling thread's shard and its histogram.
+     */
+    {
+        Library_Allocations library;
+        TimerShard *shard = cold->shards[thread_index];
+        if (shard == NULL)
+        {
+            void *memory = NULL;
+            if (posix_memalign(&memory, TIMING_CACHE_LINE, sizeof(TimerShard)) != 0)
+            {
+                log("ERROR: Could not allocate timer shard for thread %d!\n", thread_index);
+                abort();
+            }
+            shard = new (memory) TimerShard();
+            cold->shards[thread_index] = shard;
+        }
+        if (histogram != NULL and shard->histogram == NULL)
+            shard->histogram = new Histogram(histogram->precision_bits);
+        return *shard;
     }
 
     // **********************************************************
-    void Timer::Clear()
+    void Timer_Base::Clear()
     {
         is_started = false;
+        is_timed   = true;
+        sampling_countdown = 1;
         counter = 0;
-        start.Clear();
-        end.Clear();
-        current_duration.Clear();
-        duration.Clear();
+        start_ticks    = 0;
+        end_ticks      = 0;
+        current_ticks  = 0;
+        duration_ticks = 0;
+        statistics.Clear();
+        if (histogram != NULL)
+            histogram->Clear();
     }
 
     // **********************************************************
-    void Timer::Start()
+    void Timer_Base::Write_Output()
     {
-        if (not is_started)
+        // Save timing information
+        if (not cold->output_has_been_performed and not output_folder.empty())
         {
-            ++counter;
-            output_has_been_performed = false;
-            start.Get_Current_Time();
+            if (cold->output_filename == "")
+            {
+                log("ERROR: Timer's filename is empty!\n");
+                Print();
+                abort();
+            }
+
+            // The timer's clock source might not be related to the
+            // calendar: date the start from the current real time.
+            const uint64_t stop_realtime_ns = Clock_Realtime::Get_Ticks();
+            if (asynchronous_output_enabled)
+            {
+                // A threaded timer's own counter is only updated by Merge_Shards().
+                const uint64_t calls = (is_threaded ? Local_Shard(Thread_Index()).counter : counter);
+                Push_Output_Record(this, calls, timers_step, stop_realtime_ns, current_ticks);
+            }
+            else
+                Write_Output_Line(timers_step, stop_realtime_ns, current_ticks);
+
+            cold->output_has_been_performed = true;
         }
-        is_started = true;
     }
 
     // **********************************************************
-    void Timer::Stop()
+    void Timer_Base::Write_Output_Line(const uint64_t step, const uint64_t stop_realtime_ns, const uint64_t ticks)
+    /**
+     * Format and write one line of the timer's output file. Called
+     * by Stop(), or by the background writer thread if asynchronous
+     * output is enabled.
+     */
     {
-        if (is_started)
+        //log("Saving timer's output to \"%s\".\n", output_filename.c_str());
+
+        // If first write, try to open file.
+        if (not cold->output_file.is_open())
         {
-            is_started = false;
+            cold->output_file.open(cold->output_filename.c_str(), std::ios_base::out);
 
-            end.Get_Current_Time();
-            current_duration = end - start;
-            duration = duration + current_duration;
+            // Try to add a header
+            if (not cold->output_file.is_open())
+                log("ERROR: Could not open file \"%s\"!\n", cold->output_filename.c_str());
+            else
+            {
+                cold->output_file << "#    Step,               Start            , Duration\n";
+            }
         }
 
-        // Save timing information
-        if (not output_has_been_performed and not output_folder.empty())
+        // File should be opened now. Attempt write.
+        if (not cold->output_file.is_open())
+            log("ERROR: Could not open file \"%s\"!\n", cold->output_filename.c_str());
+        else
         {
-            if (output_filename != "")
-            {
-                //log("Saving timer's output to \"%s\".\n", output_filename.c_str());
+            const double current_seconds = double(ticks) * Get_Seconds_per_Tick();
+            const uint64_t start_realtime_ns = stop_realtime_ns - uint64_t(current_seconds * timing::sec_to_nanosec);
+            Clock start_date;
+            start_date.Add_sec(time_t(start_realtime_ns / uint64_t(TenToNine)));
+            start_date.Add_nsec(long(start_realtime_ns % uint64_t(TenToNine)));
+            char start_time[64];
+            start_date.Format_Time(start_time, sizeof(start_time));
+            cold->output_file << std::setw(9) << step << ", " << start_time << ", " << current_seconds << "\n";
+        }
+    }
 
-                // If first write, try to open file.
-                if (not output_file.is_open())
-                {
-                    output_file.open(output_filename.c_str(), std::ios_base::out);
-
-                    // Try to add a header
-                    if (not output_file.is_open())
-                        log("ERROR: Could not open file \"%s\"!\n", output_filename.c_str());
-                    else
-                    {
-                        output_file << "#    Step,               Start            , Duration\n";
-                    }
-                }
+    // **********************************************************
+    void Timer_Base::Flush_Output()
+    {
+        if (cold->output_file.is_open())
+            cold->output_file.flush();
+    }
 
-                // File should be opened now. Attempt write.
-                if (not output_file.is_open())
-                    log("ERROR: Could not open file \"%s\"!\n", output_filename.c_str());
-                else
-                {
-                    output_file << std::setw(9) << timers_step << ", " << start.Get_Time() << ", " << Get_Current_Duration() << "\n";
-                }
+    // **********************************************************
+    void Timer_Base::Count_Dropped_Output()
+    {
+        ++cold->output_dropped;
+    }
+
+    // **********************************************************
+    uint64_t Timer_Base::Get_Dropped_Output() const
+    {
+        return cold->output_dropped;
+    }
+
+    // **********************************************************
+    void Timer_Base::Set_Threaded(const bool _is_threaded)
+    /**
+     * Record Start()/Stop() in per-thread shards instead of the
+     * timer's own clocks. Internal timers (total, ETA, ...) stay serial.
+     */
+    {
+        is_threaded = _is_threaded;
+    }
+
+    // **********************************************************
+    bool Timer_Base::Is_Threaded() const
+    {
+        return is_threaded;
+    }
+
+    // **********************************************************
+    void Timer_Base::Set_Id(const uint32_t _id)
+    {
+        id = _id;
+    }
+
+    // **********************************************************
+    uint32_t Timer_Base::Get_Id() const
+    {
+        return id;
+    }
+
+    // **********************************************************
+    void Timer_Base::Merge_Shards()
+    /**
+     * Sum all shards into the timer's counter and duration so the
+     * merged total can be queried like a serial timer.
+     */
+    {
+        is_started = false;
+        counter = 0;
+        duration_ticks = 0;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+            {
+                counter        += cold->shards[i]->counter;
+                duration_ticks += cold->shards[i]->duration_ticks;
             }
-            else
+        }
+
+        statistics.Clear();
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                statistics.Merge(cold->shards[i]->statistics);
+        }
+
+        if (histogram != NULL)
+        {
+            histogram->Clear();
+            for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
             {
-                log("ERROR: Timer's filename is empty!\n");
-                Print();
-                abort();
+                if (cold->shards[i] != NULL and cold->shards[i]->histogram != NULL)
+                    histogram->Merge(*cold->shards[i]->histogram);
             }
+        }
+    }
 
-            output_has_been_performed = true;
+    // **********************************************************
+    int Timer_Base::Thread_Statistics(double &min, double &max, double &mean) const
+    /**
+     * Compute the minimum, maximum and mean duration over the threads
+     * that used this timer. Returns the number of such threads.
+     */
+    {
+        const double seconds_per_tick = Get_Seconds_per_Tick();
+        int nb_threads = 0;
+        double sum = 0.0;
+        min = 0.0;
+        max = 0.0;
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] == NULL)
+                continue;
+
+            const double shard_duration = double(cold->shards[i]->duration_ticks) * seconds_per_tick;
+            if (nb_threads == 0 or shard_duration < min)
+                min = shard_duration;
+            if (nb_threads == 0 or shard_duration > max)
+                max = shard_duration;
+            sum += shard_duration;
+            ++nb_threads;
         }
+        mean = (nb_threads == 0 ? 0.0 : sum / double(nb_threads));
+        return nb_threads;
+    }
+
+    // **********************************************************
+    void Timer_Base::Enable_Histogram(const int precision_bits)
+    /**
+     * Keep a histogram of the Start()/Stop() durations; see
+     * Histogram for the memory used by a given precision.
+     * Enabling it again changes the precision and clears it.
+     */
+    {
+        Library_Allocations library;
+        delete histogram;
+        histogram = new Histogram(precision_bits);
     }
 
     // **********************************************************
-    uint64_t Timer::Get_Counter() const
+    void Timer_Base::Disable_Histogram()
+    {
+        Library_Allocations library;
+        delete histogram;
+        histogram = NULL;
+    }
+
+    // **********************************************************
+    const Histogram * Timer_Base::Get_Histogram() const
+    {
+        return histogram;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Percentile(const double percent) const
+    /**
+     * Duration (seconds) below which "percent" of the Start()/Stop()
+     * pairs are. Zero if the timer has no histogram.
+     */
+    {
+        if (histogram == NULL)
+            return 0.0;
+        return double(histogram->Percentile(percent)) * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    const DurationStatistics & Timer_Base::Get_Statistics() const
+    {
+        return statistics;
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Min() const
+    /**
+     * Shortest Start()/Stop() duration, in seconds.
+     */
+    {
+        return double(statistics.min) * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Max() const
+    /**
+     * Longest Start()/Stop() duration, in seconds.
+     */
+    {
+        return double(statistics.max) * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Mean() const
+    /**
+     * Mean Start()/Stop() duration, in seconds.
+     */
+    {
+        return statistics.mean * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    double Timer_Base::Get_Standard_Deviation() const
+    /**
+     * Standard deviation of the Start()/Stop() durations, in seconds.
+     */
+    {
+        return std::sqrt(statistics.Variance()) * Get_Seconds_per_Tick();
+    }
+
+    // **********************************************************
+    uint64_t Timer_Base::Get_Counter() const
     {
         return counter;
     }
 
     // **********************************************************
-    void Timer::Add_Seconds(const double seconds)
+    void Timer_Base::Add_Seconds(const double seconds)
     /**
     * Add a number of seconds to the current Clock.
     */
     {
-        time_t nb_seconds = time_t(std::floor(seconds));
-        long nanoseconds = long((seconds - double(nb_seconds)) * timing::sec_to_nanosec);
-        end.Add_sec(nb_seconds);
-        end.Add_nsec(nanoseconds);
-        duration = end - start;
+        end_ticks += uint64_t(seconds / Get_Seconds_per_Tick());
+        duration_ticks = end_ticks - start_ticks;
     }
 
     // **********************************************************
-    time_t Timer::Get_Duration_Seconds() const
+    time_t Timer_Base::Get_Duration_Seconds() const
     /**
     * Returns Clock's elapsed duration in seconds (integer representation).
     */
     {
-        return duration.Get_sec();
+        return time_t(std::floor(Get_Duration()));
     }
 
     // **********************************************************
-    long Timer::Get_Duration_NanoSeconds() const
+    long Timer_Base::Get_Duration_NanoSeconds() const
     /**
     * Returns Clock's elapsed duration in nanoseconds (integer representation).
     */
     {
-        return duration.Get_nsec();
+        const double seconds = Get_Duration();
+        return long((seconds - std::floor(seconds)) * timing::sec_to_nanosec);
     }
 
     // **********************************************************
-    double Timer::Get_Current_Duration() const
+    double Timer_Base::Get_Current_Duration() const
     /**
     * Returns Clock's elapsed duration in seconds (float representation)
     * Only the current duration is returned, not the total cumulative.
     */
     {
-        return double(current_duration.Get_sec()) + double(current_duration.Get_nsec()) / double(timing::TenToNine);
+        return double(current_ticks) * Get_Seconds_per_Tick();
     }
 
     // **********************************************************
-    double Timer::Get_Duration() const
+    double Timer_Base::Get_Duration() const
     /**
     * Returns Clock's elapsed duration in seconds (float representation).
     */
     {
-        return double(Get_Duration_Seconds()) + double(Get_Duration_NanoSeconds()) / double(timing::TenToNine);
+        return double(duration_ticks) * Get_Seconds_per_Tick();
     }
 
     // **********************************************************
-    void Timer::Update_Duration()
-    /**
-    * Get actual time and return number of seconds (float representation) since start of Clock.
-    * NOTE: This function does NOT increment "duration" clock, it just sets it.
-    *       If the timer is stopped and restarted many times, the duration will be erased.
-    */
-    {
-        if (is_started)
-            end.Get_Current_Time();
-
-        duration = end - start;
-    }
-
-    // **********************************************************
-    uint64_t Timer::Duration_Years()
+    uint64_t Timer_Base::Duration_Years()
     /**
     * Return how many years.
     */
@@ -220,7 +515,7 @@ namespace timing
     }
 
     // **********************************************************
-    uint64_t Timer::Duration_Days()
+    uint64_t Timer_Base::Duration_Days()
     /**
     * Return how many months (not including full years).
     */
@@ -231,7 +526,7 @@ namespace timing
     }
 
     // **********************************************************
-    uint64_t Timer::Duration_Hours()
+    uint64_t Timer_Base::Duration_Hours()
     /**
     * Return how many hours (not including full years or days).
     */
@@ -243,7 +538,7 @@ namespace timing
     }
 
     // **********************************************************
-    uint64_t Timer::Duration_Minutes()
+    uint64_t Timer_Base::Duration_Minutes()
     /**
     * Return how many minutes (not including full years, days or hours).
     */
@@ -256,7 +551,7 @@ namespace timing
     }
 
     // **********************************************************
-    uint64_t Timer::Duration_Seconds()
+    uint64_t Timer_Base::Duration_Seconds()
     /**
     * Return how many minutes (not including full years, days, hours or minutes).
     */
@@ -270,42 +565,226 @@ namespace timing
     }
 
     // **********************************************************
-    std::string Timer::Duration_Human_Readable()
+    std::string Timer_Base::Duration_Human_Readable()
     /**
     * Return the duration in human readable format
     */
     {
-        //const uint64_t years    = Duration_Years();
-        const uint64_t days     = Duration_Days();
-        const uint64_t hours    = Duration_Hours();
-        const uint64_t minutes  = Duration_Minutes();
-        const uint64_t seconds  = Duration_Seconds();
+        char duration_string[64];
+        const size_t length = Format_Duration(Get_Duration(), duration_string, sizeof(duration_string));
+        return std::string(duration_string, length);
+    }
 
-        std::string duration_string;
-        if (days != 0)
-            duration_string += timing::NumberToStr(days) + std::string("d");
-        if (hours != 0 or days != 0)
-            duration_string += timing::NumberToStr(hours,2,'0') + std::string("h");
-        if (minutes != 0 or hours != 0 or days != 0)
-            duration_string += timing::NumberToStr(minutes,2,'0') + std::string("m");
-        duration_string += timing::NumberToStr(seconds,2,'0') + std::string("s");
+    // **********************************************************
+    void Timer_Base::Print() const
+    {
+        log("Timer::Print() name: %s (%p)\n", cold->name.c_str(), (void *)this);
+        log("  Clock source:     %s (%g seconds per tick)\n", Get_Clock_Name(), Get_Seconds_per_Tick());
+        log("  Start:            %" PRIu64 " ticks\n", (uint64_t) start_ticks);
+        log("  End:              %" PRIu64 " ticks\n", (uint64_t) end_ticks);
+        log("  Current Duration: %" PRIu64 " ticks\n", (uint64_t) current_ticks);
+        log("  Total Duration:   %" PRIu64 " ticks\n", (uint64_t) duration_ticks);
+    }
 
-        return duration_string;
+    // **********************************************************
+    template <class ClockSource>
+    Basic_Timer<ClockSource>::Basic_Timer()
+    /**
+     * Default constructor. The timer is started without calling
+     * Start(): a temporary timer (for example when a new entry is
+     * inserted in a map) must not appear in the call-path tree.
+     */
+    {
+        ClockSource::Initialize();
+        ++counter;
+        start_ticks = ClockSource::Get_Ticks();
+        is_started = true;
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    const char * Basic_Timer<ClockSource>::Get_Clock_Name() const
+    {
+        return ClockSource::Name();
     }
 
     // **********************************************************
-    void Timer::Print() const
+    template <class ClockSource>
+    double Basic_Timer<ClockSource>::Get_Seconds_per_Tick() const
     {
-        log("Timer::Print() name: %s (%p)\n", name.c_str(), (void *)this);
-        log("  Start:\n");
-        start.Print();
-        log("  End:\n");
-        end.Print();
-        log("  Current Duration:\n");
-        current_duration.Print();
-        log("  Total Duration:\n");
-        duration.Print();
+        return ClockSource::Seconds_per_Tick();
     }
+
+    // **********************************************************
+    template <class ClockSource>
+    void Basic_Timer<ClockSource>::_Start()
+    /**
+     * Start() with every feature enabled by the program.
+     */
+    {
+        if (is_threaded)
+        {
+            const int thread_index = Thread_Index();
+            TimerShard &shard = Local_Shard(thread_index);
+            if (not shard.is_started)
+            {
+                ++shard.counter;
+                shard.is_timed = (sampling_period == 0 or Sample_Now(shard.sampling_countdown));
+                if (shard.is_timed)
+                {
+                    if (thread_index == 0)
+                        cold->output_has_been_performed = false;
+                    if (call_path_enabled)
+                        Call_Path_Enter(this);
+                    if (perf_counters_enabled)
+                        Perf_Counters_Start(shard.perf);
+                    if (cold->usage_period != 0)
+                        Resource_Usage_Start(shard.usage, cold->usage_period);
+                    if (allocations_enabled)
+                        Allocations_Enter(this);
+                    shard.start_ticks = ClockSource::Get_Ticks();
+                }
+            }
+            shard.is_started = true;
+            return;
+        }
+
+        if (not is_started)
+        {
+            ++counter;
+            is_timed = (sampling_period == 0 or Sample_Now(sampling_countdown));
+            if (is_timed)
+            {
+                cold->output_has_been_performed = false;
+                if (call_path_enabled)
+                    Call_Path_Enter(this);
+                if (perf_counters_enabled)
+                    Perf_Counters_Start(cold->perf);
+                if (cold->usage_period != 0)
+                    Resource_Usage_Start(cold->usage, cold->usage_period);
+                if (allocations_enabled)
+                    Allocations_Enter(this);
+                start_ticks = ClockSource::Get_Ticks();
+            }
+        }
+        is_started = true;
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    void Basic_Timer<ClockSource>::_Stop()
+    /**
+     * Stop() with every feature enabled by the program.
+     */
+    {
+        if (is_threaded)
+        {
+            const int thread_index = Thread_Index();
+            TimerShard &shard = Local_Shard(thread_index);
+            const bool was_timed = (shard.is_started and shard.is_timed);
+            shard.template Stop<ClockSource>();
+            if (not was_timed)
+                return;
+            if (perf_counters_enabled)
+                Perf_Counters_Stop(shard.perf);
+            if (shard.usage != NULL)
+                Resource_Usage_Stop(shard.usage);
+            if (allocations_enabled)
+                Allocations_Exit(this, shard.allocations);
+            if (call_path_enabled)
+                Call_Path_Exit(this, shard.current_ticks);
+            if (flight_recorder_enabled)
+                Flight_Recorder_Record(id, shard.start_ticks, shard.current_ticks);
+            if (trace_enabled and ClockSource::Is_Wall_Clock())
+                Trace_Record(id, shard.current_ticks);
+            shard.statistics.Record(shard.current_ticks);
+            if (shard.histogram != NULL)
+                shard.histogram->Record(shard.current_ticks);
+
+            // Only the first registered thread saves timing information;
+            // other threads would race on the same output file.
+            if (thread_index != 0)
+                return;
+            start_ticks   = shard.start_ticks;
+            current_ticks = shard.current_ticks;
+        }
+        else if (is_started)
+        {
+            is_started = false;
+            if (not is_timed)
+                return;
+
+            end_ticks = ClockSource::Get_Ticks();
+            current_ticks = end_ticks - start_ticks;
+            duration_ticks += current_ticks;
+
+            if (perf_counters_enabled)
+                Perf_Counters_Stop(cold->perf);
+            if (cold->usage != NULL)
+                Resource_Usage_Stop(cold->usage);
+            if (allocations_enabled)
+                Allocations_Exit(this, cold->allocations);
+            if (call_path_enabled)
+                Call_Path_Exit(this, current_ticks);
+            if (flight_recorder_enabled)
+                Flight_Recorder_Record(id, start_ticks, current_ticks);
+            if (trace_enabled and ClockSource::Is_Wall_Clock())
+                Trace_Record(id, current_ticks);
+            statistics.Record(current_ticks);
+            if (histogram != NULL)
+                histogram->Record(current_ticks);
+        }
+
+        Write_Output();
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    void Basic_Timer<ClockSource>::Stop_Generic()
+    /**
+     * In threaded mode, stop every thread's shard. Must only be
+     * called once the threads are done timing (for example after
+     * a parallel region). The calling thread's shard goes through
+     * Stop() and its features (call path, allocations...).
+     */
+    {
+        const TimerShard *shard = (is_threaded ? cold->shards[Thread_Index()] : NULL);
+        if (not is_threaded or (shard != NULL and shard->is_started))
+            Stop();
+        if (not is_threaded)
+            return;
+
+        for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+        {
+            if (cold->shards[i] != NULL)
+                cold->shards[i]->template Stop<ClockSource>();
+        }
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    void Basic_Timer<ClockSource>::Update_Duration()
+    /**
+    * Get actual time and return number of seconds (float representation) since start of Clock.
+    * NOTE: This function does NOT increment "duration" clock, it just sets it.
+    *       If the timer is stopped and restarted many times, the duration will be erased.
+    */
+    {
+        if (is_started)
+            end_ticks = ClockSource::Get_Ticks();
+
+        duration_ticks = end_ticks - start_ticks;
+    }
+
+    // **********************************************************
+    // Instantiate timers for every clock source
+    template class Basic_Timer<Clock_Monotonic>;
+    template class Basic_Timer<Clock_Monotonic_Raw>;
+    template class Basic_Timer<Clock_Monotonic_Coarse>;
+    template class Basic_Timer<Clock_Thread_CPU>;
+    template class Basic_Timer<Clock_Process_CPU>;
+    template class Basic_Timer<Clock_TSC>;
+    template class Basic_Timer<Clock_TSC_Fenced>;
 } // namespace timing
 
 // ********** End of file ***************************************
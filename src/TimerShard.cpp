@@ -0,0 +1,58 @@
+#include "Timing.hpp"
+
+#include <cstring> // memset()
+
+namespace timing
+{
+    // **********************************************************
+    TimerShard::TimerShard()
+    {
+        is_started = false;
+        is_timed   = true;
+        sampling_countdown = 1;
+        counter    = 0;
+        start_ticks    = 0;
+        duration_ticks = 0;
+        current_ticks  = 0;
+        histogram      = NULL;
+        perf           = NULL;
+        usage          = NULL;
+        allocations    = NULL;
+    }
+
+    // **********************************************************
+    TimerShard::~TimerShard()
+    {
+        Library_Allocations library;
+        delete histogram;
+        delete perf;
+        delete usage;
+        delete allocations;
+    }
+
+    // **********************************************************
+    TimerCold::TimerCold()
+    {
+        output_has_been_performed = false;
+        output_dropped = 0;
+        overhead_pair_seconds = 0.0;
+        overhead_bias_ticks   = 0.0;
+        memset(shards, 0, sizeof(shards));
+        perf = NULL;
+        usage_period = 0;
+        usage = NULL;
+        allocations = NULL;
+    }
+
+    // **********************************************************
+    TimerCold::~TimerCold()
+    {
+        Library_Allocations library;
+        delete perf;
+        delete usage;
+        delete allocations;
+    }
+
+} // namespace timing
+
+// ********** End of file ***************************************
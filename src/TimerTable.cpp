@@ -0,0 +1,239 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>    // memset()
+#include <new>        // Placement new
+#include <pthread.h>  // pthread_mutex_t
+
+namespace timing
+{
+    extern bool threaded_timers;
+
+    // **********************************************************
+    // Size of a slot of the timers table. Timers of every clock
+    // source have the same layout, so any of them fits in a slot.
+    const size_t timer_slot_size = ((sizeof(Timer_Base) + TIMING_CACHE_LINE - 1) / TIMING_CACHE_LINE) * TIMING_CACHE_LINE;
+    // Size of the hash index (power of two, at most half full)
+    const uint32_t timer_index_size = 2 * TIMING_MAX_TIMERS;
+
+    // **********************************************************
+    struct TimerIndexEntry
+    /**
+     * Entry of the open-addressing hash index: name hash -> id.
+     * "hash" is published last so a reader that sees it also sees
+     * the id; zero marks an empty entry.
+     */
+    {
+        uint64_t hash;
+        Timer_Id id;
+    };
+
+    // **********************************************************
+    class TimerTable
+    /**
+     * Every timer, stored contiguously in cache-line aligned slots
+     * indexed by its id. Timers are created (but never removed) under
+     * a mutex; reading the index needs no lock. The memory is reserved
+     * for TIMING_MAX_TIMERS timers but only touched as timers are added.
+     */
+    {
+        public:
+            char *slots;
+            volatile uint32_t nb_timers;
+            TimerIndexEntry index[timer_index_size];
+            pthread_mutex_t mutex;
+
+            TimerTable()
+            {
+                Library_Allocations library;
+                void *memory = NULL;
+                if (posix_memalign(&memory, TIMING_CACHE_LINE, TIMING_MAX_TIMERS * timer_slot_size) != 0)
+                {
+                    log("ERROR: Could not allocate the timers table!\n");
+                    abort();
+                }
+                slots     = static_cast<char *>(memory);
+                nb_timers = 0;
+                memset(index, 0, sizeof(index));
+                pthread_mutex_init(&mutex, NULL);
+            }
+
+            ~TimerTable()
+            {
+                Library_Allocations library;
+                // Closes the timers' output files.
+                for (uint32_t i = 0 ; i < nb_timers ; i++)
+                {
+                    Timer_Of_Slot(i).~Timer_Base();
+                }
+                free(slots);
+                pthread_mutex_destroy(&mutex);
+            }
+
+            inline Timer_Base & Timer_Of_Slot(const Timer_Id id)
+            {
+                return *reinterpret_cast<Timer_Base *>(slots + size_t(id) * timer_slot_size);
+            }
+
+            Timer_Id Find(const std::string &name, const uint64_t hash)
+            /**
+             * Return the id of timer "name", or invalid_timer_id. Names
+             * are compared on hash match to detect collisions.
+             */
+            {
+                for (uint32_t i = uint32_t(hash) & (timer_index_size - 1) ; ; i = (i + 1) & (timer_index_size - 1))
+                {
+                    const uint64_t entry_hash = __atomic_load_n(&index[i].hash, __ATOMIC_ACQUIRE);
+                    if (entry_hash == 0)
+                        return invalid_timer_id;
+                    if (entry_hash == hash)
+                    {
+                        const Timer_Id id = index[i].id;
+                        if (Timer_Of_Slot(id).Get_Name() == name)
+                            return id;
+                        log("WARNING: Timers \"%s\" and \"%s\" have the same name hash.\n",
+                            name.c_str(), Timer_Of_Slot(id).Get_Name().c_str());
+                    }
+                }
+            }
+
+            void Insert(const uint64_t hash, const Timer_Id id)
+            {
+                uint32_t i = uint32_t(hash) & (timer_index_size - 1);
+                while (index[i].hash != 0)
+                {
+                    i = (i + 1) & (timer_index_size - 1);
+                }
+                index[i].id = id;
+                __atomic_store_n(&index[i].hash, hash, __ATOMIC_RELEASE);
+            }
+    };
+
+    // **********************************************************
+    TimerTable & Timers_Table()
+    {
+        static TimerTable table;
+        return table;
+    }
+
+    // **********************************************************
+    void Initialize_Timers_Storage()
+    /**
+     * Construct the timers table now, so it is destroyed after
+     * anything registered with atexit() later on.
+     */
+    {
+        Timers_Table();
+    }
+
+    // **********************************************************
+    uint32_t Nb_Timers()
+    {
+        return Timers_Table().nb_timers;
+    }
+
+    // **********************************************************
+    Timer_Base & Get_Timer(const Timer_Id id)
+    {
+        return Timers_Table().Timer_Of_Slot(id);
+    }
+
+    // **********************************************************
+    Timer_Id Find_Timer(const std::string &name)
+    /**
+     * Id of the timer named "name" (including the " [clock]" suffix
+     * of timers not using the default clock source), or
+     * invalid_timer_id if there is no such timer.
+     */
+    {
+        return Timers_Table().Find(name, Hash_Timer_Name(name.c_str()));
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    Basic_Timer<ClockSource> & New_Timer(const std::string &full_name, const std::string &strict_name)
+    /**
+     * Return the timer named "full_name", creating it on first use.
+     * Only the first call for a name takes the table's lock.
+     */
+    {
+        Library_Allocations library;
+        // Timers not using the default clock source get it appended to their name
+        // so the same region can be timed with different clocks side by side.
+        std::string timer_name(full_name);
+        std::string timer_strict_name(strict_name);
+        if (std::string(ClockSource::Name()) != Clock_Monotonic::Name())
+        {
+            timer_name        += std::string(" [") + ClockSource::Name() + "]";
+            timer_strict_name += std::string("_") + ClockSource::Name();
+            for (size_t i = 0 ; i < timer_strict_name.length() ; i++)
+            {
+                if (timer_strict_name[i] == ' ')
+                    timer_strict_name[i] = '_';
+            }
+        }
+
+        TimerTable &table = Timers_Table();
+        const uint64_t hash = Hash_Timer_Name(timer_name.c_str());
+        Timer_Id id = table.Find(timer_name, hash);
+        if (id != invalid_timer_id)
+            return static_cast<Basic_Timer<ClockSource> &>(table.Timer_Of_Slot(id));
+
+        pthread_mutex_lock(&table.mutex);
+        // Another thread might have created it in the meantime.
+        id = table.Find(timer_name, hash);
+        if (id == invalid_timer_id)
+        {
+            if (table.nb_timers >= TIMING_MAX_TIMERS)
+            {
+                log("ERROR: More than %d timers were created!\n", TIMING_MAX_TIMERS);
+                log("       Recompile with a larger TIMING_MAX_TIMERS.\n");
+                abort();
+            }
+            id = table.nb_timers;
+            Basic_Timer<ClockSource> *new_timer = new (table.slots + size_t(id) * timer_slot_size) Basic_Timer<ClockSource>();
+            // A default constructed timer is already running; stop it so
+            // the first TIMER_START() goes through Start().
+            new_timer->Clear();
+            new_timer->Set_Id(id);
+            new_timer->Set_Name(timer_name, timer_strict_name);
+            new_timer->Set_Threaded(threaded_timers);
+            if (Histograms_Precision() > 0)
+                new_timer->Enable_Histogram(Histograms_Precision());
+            if (Timers_Resource_Usage_Period() > 0)
+                new_timer->Enable_Resource_Usage(Timers_Resource_Usage_Period());
+            new_timer->Set_Overhead(Calibrate_Overhead<ClockSource>());
+            Flight_Recorder_Add_Timer(*new_timer);
+            __atomic_store_n(&table.nb_timers, id + 1, __ATOMIC_RELEASE);
+            table.Insert(hash, id);
+        }
+        pthread_mutex_unlock(&table.mutex);
+
+        return static_cast<Basic_Timer<ClockSource> &>(table.Timer_Of_Slot(id));
+    }
+
+    // **********************************************************
+    Timer & New_Timer(const std::string &full_name, const std::string &strict_name)
+    {
+        return New_Timer<Clock_Monotonic>(full_name, strict_name);
+    }
+
+    template Basic_Timer<Clock_Monotonic>        & New_Timer<Clock_Monotonic>       (const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_Monotonic_Raw>    & New_Timer<Clock_Monotonic_Raw>   (const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_Monotonic_Coarse> & New_Timer<Clock_Monotonic_Coarse>(const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_Thread_CPU>       & New_Timer<Clock_Thread_CPU>      (const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_Process_CPU>      & New_Timer<Clock_Process_CPU>     (const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_TSC>              & New_Timer<Clock_TSC>             (const std::string &full_name, const std::string &strict_name);
+    template Basic_Timer<Clock_TSC_Fenced>       & New_Timer<Clock_TSC_Fenced>      (const std::string &full_name, const std::string &strict_name);
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -1,6 +1,16 @@
 #include "Timing.hpp"
 
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
 #include <limits>  // http://www.cplusplus.com/reference/std/limits/numeric_limits/
+#include <algorithm> // std::nth_element()
 
 
 namespace timing
@@ -10,6 +20,14 @@ namespace timing
     // This is needed for ETA calculation.
     extern Timer TimerTotal;
 
+    // Last rate computed by a TimestepTiming (see Publish_Live_Stats()),
+    // read by the live statistics thread
+    double last_timesteps_per_second = 0.0;
+
+    // Previous timesteps whose median a timestep is compared to
+    const int stall_min_timesteps = 8;
+    const double stall_default_factor = 5.0;
+
     // **********************************************************
     TimestepTiming::TimestepTiming()
     {
@@ -17,9 +35,34 @@ namespace timing
         prev_t          = -1;
         prev_duration   = 0.0;
         nb_timesteps    = 0;
+        window_position = 0;
+        window_count    = 0;
+        stall_callback  = NULL;
+        stall_data      = NULL;
+        stall_factor    = 0.0;
+        nb_stalls       = 0;
         TimerBetweenTimesteps.Start();
     }
 
+    // **********************************************************
+    void TimestepTiming::Set_Stall_Callback(Stall_Callback callback, const double factor, void *data)
+    /**
+     * Call "callback" (with "data") when a timestep takes more than
+     * "factor" (> 1) times the median of the recent ones. Needs the
+     * durations of at least 8 previous timesteps, so the first check
+     * is on the 10th timestep reached. NULL disables the detection.
+     */
+    {
+        stall_callback = callback;
+        stall_factor   = factor;
+        stall_data     = data;
+        if (not (factor > 1.0))
+        {
+            log("WARNING: Stall factor %g must be larger than 1, using %g.\n", factor, stall_default_factor);
+            stall_factor = stall_default_factor;
+        }
+    }
+
     // **********************************************************
     void TimestepTiming::Update(const uint64_t t)
     {
@@ -32,6 +75,93 @@ namespace timing
             nb_timesteps = t - prev_t;
         }
         prev_t = t;
+
+        // Remember when timestep "t" was reached (the first time).
+        const int newest = (window_position - 1 + timestep_window) % timestep_window;
+        if (window_count == 0 or t > window_timesteps[newest])
+        {
+            window_timesteps[window_position] = t;
+            window_ticks[window_position]     = Clock_Monotonic::Get_Ticks();
+            window_position = (window_position + 1) % timestep_window;
+            window_count    = std::min(window_count + 1, timestep_window);
+            if (stall_callback != NULL)
+                Detect_Stall();
+        }
+    }
+
+    // **********************************************************
+    int TimestepTiming::Window_Durations(double durations[timestep_window]) const
+    /**
+     * Duration (s) of each timestep of the window, oldest first (a
+     * jump of several timesteps counts as as many average timesteps).
+     * Return their number.
+     */
+    {
+        const double seconds_per_tick = Clock_Monotonic::Seconds_per_Tick();
+        const int oldest = (window_position - window_count + timestep_window) % timestep_window;
+        int nb = 0;
+        for (int i = 1 ; i < window_count ; i++)
+        {
+            const int current  = (oldest + i) % timestep_window;
+            const int previous = (oldest + i - 1) % timestep_window;
+            durations[nb++] = double(window_ticks[current] - window_ticks[previous]) * seconds_per_tick
+                              / double(window_timesteps[current] - window_timesteps[previous]);
+        }
+        return nb;
+    }
+
+    // **********************************************************
+    void TimestepTiming::Detect_Stall()
+    /**
+     * Compare the last timestep to the median of the previous ones.
+     */
+    {
+        double durations[timestep_window];
+        const int nb = Window_Durations(durations);
+        if (nb < stall_min_timesteps + 1)
+            return;
+
+        const double last = durations[nb - 1];
+        double *middle = durations + (nb - 1) / 2;
+        std::nth_element(durations, middle, durations + nb - 1);
+        const double median = *middle;
+        if (last > stall_factor * median)
+        {
+            nb_stalls++;
+            stall_callback(window_timesteps[(window_position - 1 + timestep_window) % timestep_window],
+                           last, median, stall_data);
+        }
+    }
+
+    // **********************************************************
+    bool TimestepTiming::_Window_Statistics(double &timesteps_per_second, double &jitter, double &slowest) const
+    /**
+     * Over the last "timestep_window" timesteps: their rate, the
+     * standard deviation of their durations (s) and the longest
+     * one (s). Return false with fewer than two timesteps.
+     */
+    {
+        double durations[timestep_window];
+        const int nb = Window_Durations(durations);
+        if (nb == 0)
+            return false;
+
+        const int newest = (window_position - 1 + timestep_window) % timestep_window;
+        const int oldest = (window_position - window_count + timestep_window) % timestep_window;
+        const double seconds = double(window_ticks[newest] - window_ticks[oldest]) * Clock_Monotonic::Seconds_per_Tick();
+        timesteps_per_second = (seconds <= 0.0 ? 0.0 : double(window_timesteps[newest] - window_timesteps[oldest]) / seconds);
+
+        double mean = 0.0, m2 = 0.0;
+        slowest = 0.0;
+        for (int i = 0 ; i < nb ; i++)
+        {
+            const double delta = durations[i] - mean;
+            mean += delta / double(i + 1);
+            m2   += delta * (durations[i] - mean);
+            slowest = std::max(slowest, durations[i]);
+        }
+        jitter = std::sqrt(m2 / double(nb));
+        return true;
     }
 
     // **********************************************************
@@ -41,8 +171,10 @@ namespace timing
 
         if (nb_timesteps == 0 || std::abs(elapsed_time) < 1.0e-5)
             return 0.0;
-        else
-            return double(nb_timesteps) / elapsed_time;
+
+        double timesteps_per_second = double(nb_timesteps) / elapsed_time;
+        __atomic_store(&last_timesteps_per_second, &timesteps_per_second, __ATOMIC_RELAXED);
+        return timesteps_per_second;
     }
 
     // **********************************************************
@@ -69,7 +201,9 @@ namespace timing
     {
         // "tps" == timestep per second
         std::string tps_string("-");
-        const double tps = double(tmax) / TimerTotal.Get_Duration_Seconds();
+        TimerTotal.Update_Duration();
+        const double duration = TimerTotal.Get_Duration();
+        const double tps = (duration <= 0.0 ? 0.0 : double(tmax) / duration);
         return timing::NumberToStr(tps, width, fill);
     }
 
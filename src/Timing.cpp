@@ -10,17 +10,17 @@
 #define log printf
 #endif // #ifdef USE_STDCOUT
 
+#include <algorithm> // std::sort()
 #include <cstdlib>
 #include <cstring> // memset()
 #include <sys/stat.h> // Check if folder exists
+#include <pthread.h>
 
 namespace timing
 {
     // **********************************************************
     // Variables global to the library but hidden from program
 
-    // Map dynamically containing all timers
-    std::map<std::string, Timer> TimersMap;
     // This is a timer that keeps track of the total running time.
     // The constructor starts it automatically.
     // This is needed for ETA calculation.
@@ -28,18 +28,28 @@ namespace timing
     // Flags to enable/disable timing information output
     std::string output_folder;  // Directory where to save timing information
     uint64_t    timers_step;    // Current time step
+    // Timers_Feature flags currently enabled
+    uint32_t    timers_features = 0;
+    // Threaded mode: each thread records into its own TimerShard
+    bool        threaded_timers = false;
+    // Number of threads that obtained an index through Thread_Index()
+    int         nb_registered_threads = 0;
+    // Calling thread's index (-1 until Thread_Index() is first called)
+    __thread int thread_index = -1;
+    // Indices of the threads that exited, reused by the next ones
+    int             free_thread_indices[TIMING_MAX_THREADS];
+    int             nb_free_thread_indices = 0;
+    pthread_mutex_t thread_indices_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_key_t   thread_index_key;
+    pthread_once_t  thread_index_key_once = PTHREAD_ONCE_INIT;
+    // Timers output is written by a background thread
+    extern bool asynchronous_output_enabled;
 
     // **********************************************************
     // Local to this file function declarations
     void Create_Folder_If_Does_Not_Exists(const std::string path);
-
-    // **********************************************************
-    Timer & New_Timer(const std::string &full_name, const std::string &strict_name)
-    {
-        Timer &new_timer = TimersMap[full_name];
-        new_timer.Set_Name(full_name, strict_name);
-        return new_timer;
-    }
+    void Save_Report_Files();
+    void Print_Report(const uint64_t nt, const size_t terminal_width);
 
     // **********************************************************
     void Wait(const double seconds)
@@ -73,10 +83,39 @@ namespace timing
 
     // **********************************************************
     void Stop_All_Timers()
+    /**
+     * Stop every running timer, innermost first: in reverse order of
+     * the calling thread's call path if it is tracked, else in reverse
+     * order of their start on the calling thread. Shards of the other
+     * threads are stopped last.
+     */
     {
-        for (std::map<std::string, Timer>::iterator it = TimersMap.begin() ; it != TimersMap.end() ; ++it)
+        if (Call_Path_Enabled())
+            Call_Path_Stop_Running();
+
+        const int calling_thread = Thread_Index();
+        std::vector<std::pair<uint64_t, Timer_Id> > running;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            const TimerShard *shard = (timer.is_threaded ? timer.cold->shards[calling_thread] : NULL);
+            if (shard != NULL and shard->is_started)
+                running.push_back(std::make_pair(shard->start_ticks, id));
+            else if (not timer.is_threaded and timer.is_started)
+                running.push_back(std::make_pair(timer.start_ticks, id));
+        }
+        std::sort(running.begin(), running.end());
+        for (size_t i = running.size() ; i > 0 ; i--)
+        {
+            Get_Timer(running[i-1].second).Stop_Generic();
+        }
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
         {
-            it->second.Stop();
+            Timer_Base &timer = Get_Timer(id);
+            timer.Stop_Generic();
+            if (timer.Is_Threaded())
+                timer.Merge_Shards();
         }
 
         // Set total timer's name manually
@@ -84,66 +123,242 @@ namespace timing
 
         // Total timer's duration clock is updated at each time step. Clear it
         // because Stop() increments the duration using "duration = duration + (end - start)"
-        TimerTotal.duration.Clear();
+        TimerTotal.duration_ticks = 0;
 
         TimerTotal.Stop();
     }
 
     // **********************************************************
-    void Print_N_Times(const std::string x, const size_t N, const bool newline)
+    void Print_N_Times(const char *x, const size_t N, const bool newline)
     {
-        for (size_t i = 0 ; i < N ; i++)
+        // Table rules are a single character repeated.
+        if (x[0] != '\0' and x[1] == '\0')
+            Report_Repeat(x[0], N);
+        else
         {
-            log("%s", x.c_str());
+            for (size_t i = 0 ; i < N ; i++)
+            {
+                Report("%s", x);
+            }
         }
-
         if (newline)
-            log("\n");
+            Report("\n");
     }
 
     // **********************************************************
-    void Print_Code_Aspect(const std::string &s,
-                           const Timer &timer,
-                           const std::string &timer_name,
+    void Print_Code_Aspect(const char *s,
+                           const Timer_Base &timer,
+                           const char *timer_name,
                            const size_t longest_length,
                            const uint64_t nt)
+    /**
+     * Sampled timers are marked with " *".
+     */
     {
-        std::string timer_name_w_spaces("");
-        timer_name_w_spaces = timer_name;
-        timer_name_w_spaces.resize(longest_length, ' ');
-
-        log("%s| %s | %10.5g | %13.6g | %12llu | %6.2f |\n", s.c_str(),
-                                                             timer_name_w_spaces.c_str(),
-                                                             timer.Get_Duration(),
-                                                             timer.Get_Duration() / double(nt),
-                                                             timer.Get_Counter(),
-                                                             (timer.Get_Duration() / TimerTotal.Get_Duration())*100.0);
+        const char *mark = (timer.Is_Sampled() ? " *" : "");
+        Report("%s| %s%s", s, timer_name, mark);
+        Report_Repeat(' ', longest_length - std::min(longest_length, strlen(timer_name) + strlen(mark)));
+        Report(" | %10.5g | %13.6g | %12" PRIu64 " | %6.2f |\n", timer.Get_Estimated_Duration(),
+                                                            timer.Get_Estimated_Duration() / double(nt),
+                                                            timer.Get_Counter(),
+                                                            (timer.Get_Estimated_Duration() / TimerTotal.Get_Duration())*100.0);
     }
 
     // **********************************************************
-    void _Print(const uint64_t nt, const size_t terminal_width)
+    void Print_Per_Thread(const char *s, const size_t longest_length)
+    /**
+     * In threaded mode, print each timer's merged total next to the
+     * minimum, maximum and mean duration of the threads that used it.
+     */
+    {
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|  Threads   |   Merged   |       Thread duration (seconds)      |\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|            |   total    |    min     |    max     |    mean    |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            double min, max, mean;
+            const int nb_threads = Get_Timer(id).Thread_Statistics(min, max, mean);
+
+            Report("%s| ", s);
+            Report_Padded(Get_Timer(id).Get_Name().c_str(), longest_length);
+            Report(" | %10d | %10.5g | %10.5g | %10.5g | %10.5g |\n", nb_threads,
+                                                                  Get_Timer(id).Get_Duration(),
+                                                                  min, max, mean);
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Report("|------------|------------|------------|------------|------------|\n\n");
+    }
+
+    // **********************************************************
+    void Print_Per_Call(const char *s, const size_t longest_length, const bool with_percentiles)
+    /**
+     * Print the minimum, mean, standard deviation and maximum of each
+     * timer's Start()/Stop() durations, plus the percentiles of the
+     * timers having a histogram.
+     */
+    {
+        const size_t nb_columns = (with_percentiles ? 8 : 4);
+        const char *title = "Duration per call (seconds)";
+        const size_t length = 13*nb_columns - 1;
+        const size_t length_left  = (length - strlen(title)) / 2;
+        const size_t length_right =  length - strlen(title) - length_left;
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        Report("|");
+        Print_N_Times(" ", length_left, false);
+        Report("%s", title);
+        Print_N_Times(" ", length_right, false);
+        Report("|\n");
+
+        Report("%s|", s);
+        Print_N_Times(" ", longest_length+2, false);
+        if (with_percentiles)
+            Report("|    min     |    mean    |   stddev   |    p50     |    p90     |    p99     |   p99.9    |    max     |\n");
+        else
+            Report("|    min     |    mean    |   stddev   |    max     |\n");
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Print_N_Times("|------------", nb_columns, false);
+        Report("|\n");
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+
+            Report("%s| ", s);
+            Report_Padded(timer.Get_Name().c_str(), longest_length);
+            Report(" | %10.4g | %10.4g | %10.4g |", timer.Get_Min(),
+                                                  timer.Get_Mean(),
+                                                  timer.Get_Standard_Deviation());
+            if (with_percentiles)
+            {
+                if (timer.Get_Histogram() != NULL)
+                    Report(" %10.4g | %10.4g | %10.4g | %10.4g |", timer.Get_Percentile(50.0),
+                                                                timer.Get_Percentile(90.0),
+                                                                timer.Get_Percentile(99.0),
+                                                                timer.Get_Percentile(99.9));
+                else
+                    Report("          - |          - |          - |          - |");
+            }
+            Report(" %10.4g |\n", timer.Get_Max());
+        }
+
+        Report("%s|", s);
+        Print_N_Times("-", longest_length+2, false);
+        Print_N_Times("|------------", nb_columns, false);
+        Report("|\n\n");
+    }
+
+    // **********************************************************
+    void Save_Histograms()
+    /**
+     * Save each timer's histogram next to its output file.
+     */
+    {
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            const Timer_Base &timer = Get_Timer(id);
+            const Histogram *histogram = timer.Get_Histogram();
+            if (histogram == NULL)
+                continue;
+
+            std::string filename = timer.Get_Output_Filename();
+            filename.replace(filename.length() - 4, 4, "_histogram.csv");
+            histogram->Save(filename, timer.Get_Seconds_per_Tick());
+        }
+    }
+
+    // **********************************************************
+    void _Print(const uint64_t nt, const size_t terminal_width, Report_Buffer *buffer)
     /**
      *
-     *  @param  nt  Number of time steps (iterations) done in the main program.
+     *  @param  nt      Number of time steps (iterations) done in the main program.
+     *  @param  buffer  If not NULL, the report is appended to "buffer"
+     *                  instead of being printed.
      */
     {
+        // The whole report is formatted before being printed at once.
+        static Report_Buffer report;
+        report.Clear();
+        Report_Buffer *previous = Set_Report_Buffer(buffer != NULL ? buffer : &report);
+        Print_Report(nt, terminal_width);
+        Set_Report_Buffer(previous);
+        if (buffer == NULL)
+            report.Print();
+    }
+
+    // **********************************************************
+    void Save_Report_Files()
+    /**
+     * Save the histograms, allocations and call path of the report
+     * to the output folder (see TIMERS_ENABLE_OUTPUT()).
+     */
+    {
+        if (output_folder.empty())
+            return;
+
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            if (Get_Timer(id).Get_Histogram() != NULL)
+            {
+                Save_Histograms();
+                break;
+            }
+        }
+        if (Allocations_Enabled())
+            Save_Allocations(output_folder + "/allocations.csv");
+        if (Call_Path_Enabled())
+            Export_Folded_Stacks(output_folder + "/call_path.folded");
+    }
+
+    // **********************************************************
+    void Print_Report(const uint64_t nt, const size_t terminal_width)
+    /**
+     * See _Print().
+     */
+    {
+        // Every duration of the report converts ticks with this frequency.
+        Refine_TSC_Calibration();
         Stop_All_Timers();
+        // Make sure the timers' files are complete before reporting.
+        Flush_Asynchronous_Output();
+        Flush_Trace();
+        // With aggregation, only rank 0 prints (for every rank) but
+        // every rank saves its own files.
+        if (not Gather_Aggregation())
+        {
+            Save_Report_Files();
+            return;
+        }
 
         size_t longest_length = 0;
         size_t current_length = 0;
-        for (std::map<std::string, Timer>::iterator it = TimersMap.begin() ; it != TimersMap.end() ; ++it)
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
         {
-            // Find longest name
-            current_length = it->first.length();
+            // Find longest name (sampled timers are marked with " *")
+            current_length = Get_Timer(id).Get_Name().length() + (Get_Timer(id).Is_Sampled() ? 2 : 0);
             if (current_length > longest_length)
             {
                 longest_length = current_length;
             }
         }
 
-        std::string total_human_readable("Total (human readable)");
-        const std::string timings("Timing of different code aspects");
-        longest_length = std::max(longest_length, total_human_readable.length());
+        const char *total_human_readable = "Total (human readable)";
+        const char *timings = "Timing of different code aspects";
+        longest_length = std::max(longest_length, strlen(total_human_readable));
         const size_t total_length_minus_longest = 55;
         const size_t total_length = total_length_minus_longest + longest_length; // Does not include the first and last "|"
 
@@ -153,83 +368,122 @@ namespace timing
         // Else: the maximum between terminal_width and the table width will be used
         const size_t length_max = (terminal_width == 0 ? 128 : (terminal_width == 1 ? total_length : std::max(terminal_width, total_length)));
         const size_t length_s = size_t(std::floor(double(length_max - total_length+2) / 2.0));
-        const std::string s(length_s, ' ');
+        // Left margin (no allocation: the report is formatted without any)
+        char s[256];
+        const size_t margin = std::min(length_s, sizeof(s) - 1);
+        memset(s, ' ', margin);
+        s[margin] = '\0';
 
         if (terminal_width > 1)
         {
             assert(terminal_width >= terminal_width);
         }
 
-        log("%s", s.c_str());
+        Report("%s", s);
         Print_N_Times("_", total_length+2);
 
         {
-            const size_t length = timings.length();
+            const size_t length = strlen(timings);
             const size_t length_left  = (total_length - length) / 2;
             const size_t length_right =  total_length - length - length_left;
-            log("%s|", s.c_str());
+            Report("%s|", s);
             Print_N_Times(" ", length_left, false);
-            log("%s", timings.c_str());
+            Report("%s", timings);
             Print_N_Times(" ", length_right, false);
-            log("|\n");
+            Report("|\n");
         }
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times("-", total_length, false);
-        log("|\n");
+        Report("|\n");
 
         {
-            const std::string code_aspects("Code Aspect");
-            const size_t length = code_aspects.length();
+            const char *code_aspects = "Code Aspect";
+            const size_t length = strlen(code_aspects);
             const size_t length_left  = (longest_length+2 - length) / 2;
             const size_t length_right =  longest_length+2 - length - length_left;
-            log("%s|", s.c_str());
+            Report("%s|", s);
             Print_N_Times(" ", length_left, false);
-            log("%s", code_aspects.c_str());
+            Report("%s", code_aspects);
             Print_N_Times(" ", length_right, false);
-            log("|");
+            Report("|");
         }
-        log("          Duration          | Number times | Total  |\n");
+        Report("          Duration          | Number times | Total  |\n");
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times(" ", longest_length+2, false);
-        log("|  seconds   | per time step |    called    |   %c    |\n", '%');
+        Report("|  seconds   | per time step |    called    |   %c    |\n", '%');
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times("-", longest_length+2, false);
-        log("|------------|---------------|--------------|--------|\n");
+        Report("|------------|---------------|--------------|--------|\n");
 
-        for (std::map<std::string, Timer>::iterator it = TimersMap.begin() ; it != TimersMap.end(); ++it )
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
         {
-            Print_Code_Aspect(s, TimersMap[it->first], it->first, longest_length, nt);
+            const Timer_Base &timer = Get_Timer(id);
+            Print_Code_Aspect(s, timer, timer.Get_Name().c_str(), longest_length, nt);
         }
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times("-", longest_length+2, false);
-        log("|------------|---------------|--------------|--------|\n");
+        Report("|------------|---------------|--------------|--------|\n");
 
         // Print total last
         Print_Code_Aspect(s, TimerTotal, "Total", longest_length, nt);
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times("-", longest_length+2, false);
-        log("|----------------------------------------------------|\n");
+        Report("|----------------------------------------------------|\n");
 
-        total_human_readable.resize(longest_length, ' ');
-        log("%s| %s | %50s |\n", s.c_str(), total_human_readable.c_str(), TimerTotal.Duration_Human_Readable().c_str());
+        char total_duration[64];
+        Format_Duration(TimerTotal.Get_Duration(), total_duration, sizeof(total_duration));
+        Report("%s| ", s);
+        Report_Padded(total_human_readable, longest_length);
+        Report(" | %50s |\n", total_duration);
 
-        log("%s|", s.c_str());
+        Report("%s|", s);
         Print_N_Times("-", total_length, false);
-        log("|\n\n");
+        Report("|\n\n");
+
+        Print_Sampled(s, longest_length);
+        Print_Overhead(s, longest_length);
+
+        if (threaded_timers)
+            Print_Per_Thread(s, longest_length);
+        Print_Parallel_Regions(s, longest_length);
+
+        bool has_histograms = false;
+        for (Timer_Id id = 0 ; id < Nb_Timers() ; id++)
+        {
+            if (Get_Timer(id).Get_Histogram() != NULL)
+                has_histograms = true;
+        }
+        Print_Per_Call(s, longest_length, has_histograms);
+        Print_Perf_Counters(s, longest_length);
+        Print_Resource_Usage(s, longest_length);
+        Print_Allocations(s, longest_length);
+
+        if (asynchronous_output_enabled)
+            Print_Asynchronous_Output(s, longest_length);
+
+        Print_Aggregation(s, longest_length);
+
+        Print_TSC_Information();
+        Print_Timers_Categories();
+
+        if (Call_Path_Enabled())
+            Print_Call_Path();
+
+        Save_Report_Files();
 
         time_t rawtime;
         time(&rawtime);
         const int timing_max_string_size = 1000;
         char date_out[timing_max_string_size];      // Output string
-        struct tm *date_format; // Saves in Date format
-        date_format = localtime(&rawtime);
-        strftime(date_out, timing_max_string_size, "%A, %B %dth %Y, %Hh%M:%S (%Y%m%d%H%M%S)", date_format);
-        log("\nEnding time and date:\n    %s\n", date_out);
+        struct tm date_format; // Saves in Date format
+        localtime_r(&rawtime, &date_format);
+        strftime(date_out, timing_max_string_size, "%A, %B %dth %Y, %Hh%M:%S (%Y%m%d%H%M%S)", &date_format);
+        Report("\nEnding time and date:\n    %s\n", date_out);
     }
 
     // **************************************************************
@@ -242,7 +496,7 @@ namespace timing
             const int return_value = system(cmd.c_str());
             if (return_value != 0)
             {
-                log("ERROR: Folder '%s' could not be created correclty!\n");
+                log("ERROR: Folder '%s' could not be created correclty!\n", path.c_str());
                 log("       Disabling timing output.\n");
                 output_folder = "";
             }
@@ -262,6 +516,10 @@ namespace timing
             log("         To use the current folder, just use \"./\" instead.\n");
         }
         output_folder = _output_folder;
+        if (output_folder.empty())
+            timers_features &= ~uint32_t(FEATURE_OUTPUT);
+        else
+            timers_features |= FEATURE_OUTPUT;
         log("Timing information will be saved in \"%s\".\n", output_folder.c_str());
         Create_Folder_If_Does_Not_Exists(output_folder);
     }
@@ -273,6 +531,82 @@ namespace timing
      */
     {
         timers_step = _step;
+        Trace_Step(_step);
+        Interval_Report_Step(_step);
+    }
+
+    // **********************************************************
+    void Enable_Threaded_Timers()
+    /**
+     * Enable threaded mode: every thread records into its own shard
+     * of each timer and shards are merged by timing::Print().
+     * The calling thread gets index 0 and is the only one saving
+     * timing information to files.
+     * If used, _must_ be called _before_ any TIMER_START() and
+     * outside of any parallel region.
+     */
+    {
+        Thread_Index();
+        threaded_timers = true;
+    }
+
+    // **********************************************************
+    bool Threaded_Timers_Enabled()
+    {
+        return threaded_timers;
+    }
+
+    // **********************************************************
+    void Release_Thread_Index(void *value)
+    /**
+     * Called when a thread that has an index exits: its index (and
+     * its shards, flight recorder ring, trace buffer and call-path
+     * tree) goes to the next thread asking for one.
+     */
+    {
+        const int index = int(reinterpret_cast<intptr_t>(value)) - 1;
+        pthread_mutex_lock(&thread_indices_mutex);
+        free_thread_indices[nb_free_thread_indices++] = index;
+        pthread_mutex_unlock(&thread_indices_mutex);
+    }
+
+    // **********************************************************
+    void Create_Thread_Index_Key()
+    {
+        pthread_key_create(&thread_index_key, Release_Thread_Index);
+    }
+
+    // **********************************************************
+    int Thread_Index()
+    /**
+     * Return the calling thread's index, assigning one on the first
+     * call from a thread: the index of a thread that exited if any,
+     * else the next unused one. Only TIMING_MAX_THREADS threads can
+     * have an index at the same time.
+     */
+    {
+        if (thread_index < 0)
+        {
+            pthread_once(&thread_index_key_once, Create_Thread_Index_Key);
+
+            pthread_mutex_lock(&thread_indices_mutex);
+            if (nb_free_thread_indices > 0)
+                thread_index = free_thread_indices[--nb_free_thread_indices];
+            else if (nb_registered_threads < TIMING_MAX_THREADS)
+                thread_index = __atomic_fetch_add(&nb_registered_threads, 1, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&thread_indices_mutex);
+
+            if (thread_index < 0)
+            {
+                log("ERROR: More than %d threads are using timers at the same time!\n", TIMING_MAX_THREADS);
+                log("       Recompile with a larger TIMING_MAX_THREADS.\n");
+                abort();
+            }
+            // The main thread's index is never released (its key's
+            // destructor doesn't run at exit()).
+            pthread_setspecific(thread_index_key, reinterpret_cast<void *>(intptr_t(thread_index) + 1));
+        }
+        return thread_index;
     }
 
 } // namespace timing
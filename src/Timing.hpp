@@ -2,14 +2,26 @@
 #define _INC_TIMING_hpp
 
 #include <map>
+#include <vector>
 #include <string>
 #include <cstdio>
+#include <cstdarg>  // va_list
 #include <cmath>
 #include <time.h>  // timespec
 #include <sstream> // Defines also "timespec"
 #include <cassert>
 #include <stdint.h> // (u)int64_t
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif // #ifndef __STDC_FORMAT_MACROS
+#include <inttypes.h> // PRIu64
 #include <fstream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc(), __rdtscp(), _mm_lfence()
+#endif // #if defined(__x86_64__) || defined(__i386__)
+#ifdef PARALLEL_MPI
+#include <mpi.h>
+#endif // #ifdef PARALLEL_MPI
 
 // Quote something, usefull to quote a macro's value
 #ifndef _QUOTEME
@@ -30,43 +42,372 @@
     #define TIMER_START(name, Timer_name) \
         static timing::Timer &Timer_name = timing::New_Timer(name, QUOTEME(Timer_name)); \
         Timer_name.Start();
+    #define TIMER_START_CLOCK(name, Timer_name, ClockSource) \
+        static timing::Basic_Timer<timing::ClockSource> &Timer_name = timing::New_Timer<timing::ClockSource>(name, QUOTEME(Timer_name)); \
+        Timer_name.Start();
     #define TIMER_STOP(name, Timer_name) \
         Timer_name.Stop();
+    #define TIMER_START_SAMPLED(name, Timer_name, period, randomized) \
+        static timing::Timer &Timer_name = timing::Sampled(timing::New_Timer(name, QUOTEME(Timer_name)), period, randomized); \
+        Timer_name.Start();
+    #define TIMER_START_LEVEL(name, Timer_name, category, level) \
+        static timing::Timer *Timer_name = NULL; \
+        if (timing::Timer_Enabled(category, level)) { \
+            if (Timer_name == NULL) Timer_name = &timing::New_Timer(name, QUOTEME(Timer_name)); \
+            Timer_name->Start(); \
+        }
+    #define TIMER_STOP_LEVEL(name, Timer_name, category, level) \
+        do { \
+            if (timing::Timer_Compiled(category, level) and Timer_name != NULL) \
+                Timer_name->Stop(); \
+        } while (0)
+    #define TIMER_START_PARALLEL(name, Region_name) \
+        static timing::Parallel_Region &Region_name = timing::New_Parallel_Region(name, QUOTEME(Region_name)); \
+        Region_name.Start();
+    #define TIMER_STOP_PARALLEL(name, Region_name) \
+        Region_name.Stop();
+    #define TIMER_THREAD_ENTER(Region_name) \
+        Region_name.Thread_Enter();
+    #define TIMER_THREAD_EXIT(Region_name) \
+        Region_name.Thread_Exit();
     #define TIMERS_ENABLE_OUTPUT(output_folder) \
         timing::Enable_Timers_Output(output_folder);
     #define TIMERS_SET_STEP(step) \
         timing::Set_Timers_Step(step);
+    #define TIMERS_ENABLE_THREADED() \
+        timing::Enable_Threaded_Timers();
+    #define TIMERS_ENABLE_CALL_PATH() \
+        timing::Enable_Call_Path();
+    #define TIMERS_ENABLE_FLIGHT_RECORDER(nb_records) \
+        timing::Enable_Flight_Recorder(nb_records);
+    #define TIMERS_ENABLE_ASYNCHRONOUS_OUTPUT(policy, queue_size) \
+        timing::Enable_Asynchronous_Output(timing::policy, queue_size);
+    #define TIMERS_ENABLE_TRACE(filename) \
+        timing::Enable_Trace(filename);
+    #define TIMERS_ENABLE_PERF_COUNTERS() \
+        timing::Enable_Perf_Counters();
+    #define TIMERS_ENABLE_RESOURCE_USAGE(period) \
+        timing::Enable_Timers_Resource_Usage(period);
+    #define TIMERS_ENABLE_ALLOCATIONS() \
+        timing::Enable_Allocations();
+    #define TIMERS_ENABLE_LIVE_STATS(interval) \
+        timing::Enable_Live_Stats(interval);
+    #define TIMERS_ENABLE_INTERVAL_REPORT(filename, every_steps, every_seconds) \
+        timing::Enable_Interval_Report(filename, every_steps, every_seconds);
+    #define TIMERS_ENABLE_HISTOGRAMS(precision_bits) \
+        timing::Enable_Histograms(precision_bits);
+    #define TIMERS_ENABLE_AGGREGATION(transport) \
+        timing::Enable_Aggregation(transport);
 #else // #ifndef DISABLE_TIMING
     #define TIMER_START(name, Timer_name)       {}
+    #define TIMER_START_CLOCK(name, Timer_name, ClockSource) {}
     #define TIMER_STOP(name, Timer_name)        {}
+    #define TIMER_START_SAMPLED(name, Timer_name, period, randomized) {}
+    #define TIMER_START_LEVEL(name, Timer_name, category, level) {}
+    #define TIMER_STOP_LEVEL(name, Timer_name, category, level)  {}
+    #define TIMER_START_PARALLEL(name, Region_name) {}
+    #define TIMER_STOP_PARALLEL(name, Region_name)  {}
+    #define TIMER_THREAD_ENTER(Region_name)         {}
+    #define TIMER_THREAD_EXIT(Region_name)          {}
     #define TIMERS_ENABLE_OUTPUT(output_folder) {}
     #define TIMERS_SET_STEP(step)               {}
+    #define TIMERS_ENABLE_THREADED()            {}
+    #define TIMERS_ENABLE_CALL_PATH()           {}
+    #define TIMERS_ENABLE_FLIGHT_RECORDER(nb_records) {}
+    #define TIMERS_ENABLE_ASYNCHRONOUS_OUTPUT(policy, queue_size) {}
+    #define TIMERS_ENABLE_TRACE(filename)       {}
+    #define TIMERS_ENABLE_PERF_COUNTERS()       {}
+    #define TIMERS_ENABLE_RESOURCE_USAGE(period) {}
+    #define TIMERS_ENABLE_ALLOCATIONS()         {}
+    #define TIMERS_ENABLE_LIVE_STATS(interval)  {}
+    #define TIMERS_ENABLE_INTERVAL_REPORT(filename, every_steps, every_seconds) {}
+    #define TIMERS_ENABLE_HISTOGRAMS(precision_bits) {}
+    #define TIMERS_ENABLE_AGGREGATION(transport) {}
 #endif // #ifndef DISABLE_TIMING
 
+// Maximum number of threads that can time a region at the same time.
+// Both the library and the program must be compiled with the same value.
+#ifndef TIMING_MAX_THREADS
+#define TIMING_MAX_THREADS 256
+#endif // #ifndef TIMING_MAX_THREADS
+// Timer categories are bits of a 32 bits mask and levels go from
+// TIMING_LEVEL_COARSE to TIMING_LEVEL_DEBUG. Timers of categories
+// not in TIMING_COMPILED_CATEGORIES or of a level above
+// TIMING_COMPILED_LEVEL are removed at compile time.
+#define TIMING_CATEGORY(n)      (1u << (n))
+#define TIMING_LEVEL_COARSE     0
+#define TIMING_LEVEL_NORMAL     1
+#define TIMING_LEVEL_FINE       2
+#define TIMING_LEVEL_DEBUG      3
+#define TIMING_NB_LEVELS        4
+#ifndef TIMING_COMPILED_CATEGORIES
+#define TIMING_COMPILED_CATEGORIES 0xFFFFFFFFu
+#endif // #ifndef TIMING_COMPILED_CATEGORIES
+#ifndef TIMING_COMPILED_LEVEL
+#define TIMING_COMPILED_LEVEL   TIMING_LEVEL_DEBUG
+#endif // #ifndef TIMING_COMPILED_LEVEL
+
+// Maximum number of timers. Memory for their table is reserved once
+// (only the pages of the timers actually created are used).
+#ifndef TIMING_MAX_TIMERS
+#define TIMING_MAX_TIMERS 4096
+#endif // #ifndef TIMING_MAX_TIMERS
+// Per-thread data is aligned on cache lines to prevent false sharing.
+#ifndef TIMING_CACHE_LINE
+#define TIMING_CACHE_LINE 64
+#endif // #ifndef TIMING_CACHE_LINE
+
 // **************************************************************
 namespace timing
 {
     // Forward declarations
+    class Clock_Monotonic;
     class Clock;
-    class Timer;
+    class Histogram;
+    class DurationStatistics;
+    class TimerShard;
+    class Timer_Base;
+    template <class ClockSource> class Basic_Timer;
+    class CallPathNode;
+    class Aggregation_Transport;
+    class Parallel_Region;
+    struct PerfCounts;
+    struct ResourceUsage;
+    struct AllocationCounts;
     class Eta;
 
+    // Timers are identified by their index in the timers table
+    typedef uint32_t Timer_Id;
+    const Timer_Id invalid_timer_id = 0xFFFFFFFF;
+
+    // **********************************************************
+    inline uint64_t Hash_Timer_Name(const char *name)
+    /**
+     * 64 bits FNV-1a hash of a timer's name. Never zero.
+     */
+    {
+        // Constants written without "ULL" suffix (C++98)
+        const uint64_t prime = (uint64_t(1) << 40) + 0x1b3;
+        uint64_t hash = (uint64_t(0xcbf29ce4) << 32) | uint64_t(0x84222325);
+        for ( ; *name != '\0' ; ++name)
+        {
+            hash ^= uint64_t((unsigned char) *name);
+            hash *= prime;
+        }
+        return (hash == 0 ? 1 : hash);
+    }
+
     // **********************************************************
-    Timer & New_Timer(const std::string &full_name, const std::string &strict_name);
+    template <class ClockSource>
+    Basic_Timer<ClockSource> & New_Timer(const std::string &full_name, const std::string &strict_name);
+    Basic_Timer<Clock_Monotonic> & New_Timer(const std::string &full_name, const std::string &strict_name);
+    uint32_t Nb_Timers();
+    Timer_Base & Get_Timer(const Timer_Id id);
+    Timer_Id Find_Timer(const std::string &name);
     void Wait(const double seconds);
-    void Print_N_Times(const std::string x, const size_t N, const bool newline = true);
-    void _Print(const uint64_t nt, const size_t terminal_width);
+    void Print_N_Times(const char *x, const size_t N, const bool newline = true);
+    class Report_Buffer;
+    void _Print(const uint64_t nt, const size_t terminal_width, Report_Buffer *buffer = NULL);
 #ifndef DISABLE_TIMING
     inline void Print(const uint64_t nt, const size_t terminal_width = 1) { _Print(nt, terminal_width);   }
+    inline void Print(const uint64_t nt, Report_Buffer &buffer, const size_t terminal_width = 1)
+                                                                          { _Print(nt, terminal_width, &buffer); }
 #else // #ifndef DISABLE_TIMING
     inline void Print(const uint64_t nt, const size_t terminal_width = 1) { /* Don't do anything */       }
+    inline void Print(const uint64_t nt, Report_Buffer &buffer, const size_t terminal_width = 1)
+                                                                          { /* Don't do anything */       }
 #endif // #ifndef DISABLE_TIMING
 
     std::string Duration_Human_Readable();
     double Get_Total_Duration();
+    void Write_Summary_JSON(std::ostream &stream, const uint64_t nt);
+    void Write_Summary_CSV(std::ostream &stream, const uint64_t nt);
+    bool Export_Summary(const uint64_t nt, const std::string &basename = "");
     void Stop_All_Timers();
     void Enable_Timers_Output(const std::string &_output_folder);
     void Set_Timers_Step(const uint64_t _step);
+    void Enable_Threaded_Timers();
+    bool Threaded_Timers_Enabled();
+    int  Thread_Index();
+
+    void Enable_Call_Path();
+    bool Call_Path_Enabled();
+    void Call_Path_Enter(const Timer_Base *timer);
+    void Call_Path_Exit(const Timer_Base *timer, const uint64_t ticks);
+    void Call_Path_Stop_Running();
+    double Call_Path_Nested_Overhead(const Timer_Base *timer);
+    void Print_Call_Path();
+    void Refine_TSC_Calibration();
+    void Print_TSC_Information();
+    void Export_Folded_Stacks(const std::string &filename);
+
+    void Enable_Flight_Recorder(const uint64_t nb_records_per_thread = 65536);
+    bool Flight_Recorder_Enabled();
+    bool Dump_Flight_Recorder(const std::string &filename);
+    void Dump_Flight_Recorder_On_Signal(const int signal_number, const std::string &filename);
+    void Dump_Flight_Recorder_On_Crash(const std::string &filename);
+
+    // Events counted by Enable_Perf_Counters()
+    enum Perf_Event
+    {
+        PERF_CYCLES = 0,
+        PERF_INSTRUCTIONS,
+        PERF_CACHE_REFERENCES,
+        PERF_CACHE_MISSES,
+        PERF_BRANCHES,
+        PERF_BRANCH_MISSES,
+        PERF_PAGE_FAULTS,
+        PERF_CONTEXT_SWITCHES,
+        PERF_NB_EVENTS
+    };
+    const uint32_t perf_all_events      = (1u << PERF_NB_EVENTS) - 1;
+    const uint32_t perf_hardware_events = (1u << PERF_PAGE_FAULTS) - 1;
+    void Enable_Perf_Counters(const uint32_t events = perf_all_events);
+    bool Perf_Counters_Enabled();
+    void Perf_Counters_Start(PerfCounts *&counts);
+    void Perf_Counters_Stop(PerfCounts *counts);
+    void Print_Perf_Counters(const char *s, const size_t longest_length);
+
+    // Quantities measured by Enable_Timers_Resource_Usage()
+    enum Resource_Usage_Field
+    {
+        USAGE_WALL_NS = 0,
+        USAGE_USER_US,
+        USAGE_SYSTEM_US,
+        USAGE_MINOR_FAULTS,
+        USAGE_MAJOR_FAULTS,
+        USAGE_VOLUNTARY_SWITCHES,
+        USAGE_INVOLUNTARY_SWITCHES,
+        USAGE_MAXRSS_KB,
+        USAGE_NB_FIELDS
+    };
+    void Enable_Timers_Resource_Usage(const uint32_t period = 1);
+    uint32_t Timers_Resource_Usage_Period();
+    void Resource_Usage_Start(ResourceUsage *&usage, const uint32_t period);
+    void Resource_Usage_Stop(ResourceUsage *usage);
+    void Print_Resource_Usage(const char *s, const size_t longest_length);
+
+    void Enable_Allocations();
+    bool Allocations_Enabled();
+    void Allocations_Enter(const Timer_Base *timer);
+    void Allocations_Exit(const Timer_Base *timer, AllocationCounts *&counts);
+    void Print_Allocations(const char *s, const size_t longest_length);
+    bool Save_Allocations(const std::string &filename);
+
+    // **********************************************************
+    // Live statistics file (see Enable_Live_Stats()), read by timing-top:
+    // a Live_Stats_Header followed by "capacity" Live_Stats_Timer.
+    const char     live_stats_prefix[]    = "/dev/shm/timing.";
+    const char     live_stats_magic[8]    = "TIMSTAT";
+    const uint32_t live_stats_version     = 1;
+    const size_t   live_stats_name_length = 64;
+
+    // **********************************************************
+    struct Live_Stats_Header
+    /**
+     * "sequence" is odd while the process updates the file: a reader
+     * copies the file between two equal and even reads of it.
+     */
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t capacity;              // Number of Live_Stats_Timer
+        uint64_t sequence;
+        int64_t  pid;
+        uint32_t nb_timers;
+        uint32_t is_finished;           // The process stopped updating
+        uint64_t step;                  // See Set_Timers_Step()
+        uint64_t update_ns;             // CLOCK_REALTIME of the update
+        double   interval;              // Seconds between updates
+        double   elapsed_seconds;       // Since Enable_Live_Stats()
+        double   timesteps_per_second;  // Last rate of a TimestepTiming
+    } __attribute__((aligned(TIMING_CACHE_LINE)));
+
+    // **********************************************************
+    struct Live_Stats_Timer
+    {
+        char     name[live_stats_name_length];  // Truncated
+        uint64_t calls;
+        uint64_t timed_calls;           // Less than "calls" if sampled
+        double   seconds;               // Of every call (estimated if sampled)
+        double   last_seconds;          // Of the last timed call
+    };
+
+    void Enable_Live_Stats(const double interval = 1.0, const std::string &filename = "");
+    bool Live_Stats_Enabled();
+    void Publish_Live_Stats();
+    void Stop_Live_Stats();
+
+    void Enable_Interval_Report(const std::string &filename, const uint64_t every_steps, const double every_seconds = 0.0);
+    bool Interval_Report_Enabled();
+    void Interval_Report_Step(const uint64_t step);
+    void Write_Interval_Report();
+    void Close_Interval_Report();
+
+    void Enable_Trace(const std::string &filename, const uint64_t nb_events_per_thread = 65536);
+    bool Trace_Enabled();
+    void Trace_Record(const uint32_t timer_id, const uint64_t duration_ticks);
+    void Trace_Step(const uint64_t step);
+    void Flush_Trace();
+    void Close_Trace();
+
+    // What Stop() does when the background writer falls behind
+    enum Output_Policy
+    {
+        OUTPUT_BLOCK,   // Wait for room in the queue
+        OUTPUT_DROP,    // Drop the record and count it
+        OUTPUT_SAMPLE   // Keep one record in eight when the queue is almost full
+    };
+    void Enable_Asynchronous_Output(const Output_Policy policy = OUTPUT_BLOCK, const uint64_t queue_size = 65536);
+    void Flush_Asynchronous_Output();
+    void Stop_Asynchronous_Output();
+    void Push_Output_Record(Timer_Base *timer, const uint64_t calls, const uint64_t step, const uint64_t stop_realtime_ns, const uint64_t ticks);
+    void Print_Asynchronous_Output(const char *s, const size_t longest_length);
+
+    uint32_t Next_Sampling_Countdown(const uint32_t period, const bool randomized);
+    void Print_Sampled(const char *s, const size_t longest_length);
+
+    Parallel_Region & New_Parallel_Region(const std::string &full_name, const std::string &strict_name);
+    void Print_Parallel_Regions(const char *s, const size_t longest_length);
+
+    void Enable_Aggregation(Aggregation_Transport *transport);
+    bool Aggregation_Enabled();
+    bool Gather_Aggregation();
+    void Print_Aggregation(const char *s, const size_t longest_length);
+
+    void Enable_Histograms(const int precision_bits = 5);
+    int  Histograms_Precision();
+
+    // Categories enabled at each level (see Set_Timers_Categories())
+    extern uint32_t timers_level_masks[TIMING_NB_LEVELS];
+    void Set_Timers_Categories(const uint32_t categories);
+    void Enable_Timers_Categories(const uint32_t categories);
+    void Disable_Timers_Categories(const uint32_t categories);
+    void Set_Timers_Level(const int level);
+    uint32_t Get_Timers_Categories();
+    int  Get_Timers_Level();
+    void Print_Timers_Categories();
+
+    // **********************************************************
+    inline bool Timer_Compiled(const uint32_t category, const int level)
+    /**
+     * False if the timer was removed at compile time. Both arguments
+     * are usually constants so the test disappears.
+     */
+    {
+        return ((category & TIMING_COMPILED_CATEGORIES) != 0 and level >= 0
+                and level <= TIMING_COMPILED_LEVEL and level < TIMING_NB_LEVELS);
+    }
+
+    // **********************************************************
+    inline bool Timer_Enabled(const uint32_t category, const int level)
+    /**
+     * Is a timer of "category" and "level" enabled? Once compiled in,
+     * a single test of the cached mask of its level.
+     */
+    {
+        return (Timer_Compiled(category, level) and (timers_level_masks[level] & category) != 0);
+    }
 
     // **********************************************************
     template <class Number>
@@ -84,6 +425,59 @@ namespace timing
         MyStream << integer << std::flush;
         return (MyStream.str());
     }
+    // Integers are formatted without a stream (see Report.cpp)
+    std::string NumberToStr(const int integer, const int width = 0, const char fill = ' ');
+    std::string NumberToStr(const unsigned int integer, const int width = 0, const char fill = ' ');
+    std::string NumberToStr(const long integer, const int width = 0, const char fill = ' ');
+    std::string NumberToStr(const unsigned long integer, const int width = 0, const char fill = ' ');
+    char * Unsigned_To_Chars(char *first, char *last, uint64_t value);
+
+    // **********************************************************
+    class Report_Buffer
+    /**
+     * Text of a report, formatted in place and printed with a single
+     * write. Uses the caller's buffer if given (truncating what does
+     * not fit), else its own, which grows as needed and is kept by
+     * Clear() so a buffer reused for every report stops allocating.
+     */
+    {
+        private:
+            char   *data;
+            size_t  capacity;
+            size_t  length;
+            bool    is_owner;
+            bool    is_truncated;
+
+            size_t Available(const size_t wanted);
+            // Not copyable
+            Report_Buffer(const Report_Buffer &);
+            Report_Buffer & operator=(const Report_Buffer &);
+
+        public:
+            Report_Buffer();
+            Report_Buffer(char *buffer, const size_t size);
+            ~Report_Buffer();
+
+            void Clear();
+            void Append(const char *text, const size_t n);
+            void Append(const char *text);
+            void Append(const std::string &text);
+            void Repeat(const char c, const size_t n);
+            void Append_Unsigned(const uint64_t value, const int width = 0, const char fill = ' ');
+            void Append_Duration(const double seconds);
+            void Printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+            void VPrintf(const char *format, va_list arguments);
+
+            inline const char * Data() const    { return (data == NULL ? "" : data); }
+            inline size_t Length() const        { return length; }
+            inline bool Is_Truncated() const    { return is_truncated; }
+            void Print() const;
+    };
+
+    Report_Buffer * Set_Report_Buffer(Report_Buffer *buffer);
+    void Report(const char *format, ...) __attribute__((format(printf, 1, 2)));
+    void Report_Repeat(const char c, const size_t n);
+    void Report_Padded(const char *text, const size_t width);
 
     // **********************************************************
     // See Git_Info.cpp (generated dynamically from Git_Info.cpp_template & Makefile.rules)
@@ -109,8 +503,192 @@ namespace timing
     const double sec_to_nanosec     = 1.0e9;
     const double nanosec_to_sec     = 1.0 / sec_to_nanosec;
 
+    // **********************************************************
+    // Clock sources. Each one reads the current time of a specific
+    // clock through static inline functions so that the choice is
+    // resolved at compile time:
+    //   Get_Time()         Current time as a timespec
+    //   Get_Ticks()        Current time as raw 64-bit ticks; timers
+    //                      only store ticks in their hot path
+    //   Seconds_per_Tick() Conversion used when reporting
+    //   Initialize()       Called once before the first Get_Ticks()
+    //   Is_Wall_Clock()    Does it measure elapsed (wall-clock) time?
+    void Clock_Error(const char *clock_name);
+
+    inline uint64_t Timespec_To_Nanoseconds(const timespec &t)
+    {
+        return uint64_t(t.tv_sec) * uint64_t(TenToNine) + uint64_t(t.tv_nsec);
+    }
+
+    // "CLOCK_MONOTONIC" is reliable clock, but measures RELATIVE time!
+    // It does NOT start at epoc! It is not affected by clock changes
+    // but can be slewed by NTP.
+    class Clock_Monotonic
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+                if (clock_gettime(CLOCK_MONOTONIC, &t) != 0)
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "monotonic"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // "CLOCK_MONOTONIC_RAW" is not affected by NTP slewing (Linux only).
+    class Clock_Monotonic_Raw
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+#ifdef CLOCK_MONOTONIC_RAW
+                if (clock_gettime(CLOCK_MONOTONIC_RAW, &t) != 0)
+#else // #ifdef CLOCK_MONOTONIC_RAW
+                if (clock_gettime(CLOCK_MONOTONIC, &t) != 0)
+#endif // #ifdef CLOCK_MONOTONIC_RAW
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "monotonic raw"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // "CLOCK_MONOTONIC_COARSE" is faster to read but only has the
+    // resolution of the kernel tick (Linux only).
+    class Clock_Monotonic_Coarse
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+#ifdef CLOCK_MONOTONIC_COARSE
+                if (clock_gettime(CLOCK_MONOTONIC_COARSE, &t) != 0)
+#else // #ifdef CLOCK_MONOTONIC_COARSE
+                if (clock_gettime(CLOCK_MONOTONIC, &t) != 0)
+#endif // #ifdef CLOCK_MONOTONIC_COARSE
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "monotonic coarse"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // "CLOCK_THREAD_CPUTIME_ID" measure the time taken by the calling thread on the CPU.
+    class Clock_Thread_CPU
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+                if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0)
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "thread cpu"; }
+            static inline bool Is_Wall_Clock()     { return false; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // "CLOCK_PROCESS_CPUTIME_ID" measure the time taken by the process on the CPU.
+    // If the process is sleeping (using timing::Wait() for example), the time passed
+    // sleeping will not be counted!
+    class Clock_Process_CPU
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+                if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0)
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "process cpu"; }
+            static inline bool Is_Wall_Clock()     { return false; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // "CLOCK_REALTIME" might have trouble in 2038 and is affected by clock changes (NTP)
+    // It starts at epoc (1970). Only used to get dates, not to time code.
+    class Clock_Realtime
+    {
+        public:
+            static inline void Get_Time(timespec &t)
+            {
+                if (clock_gettime(CLOCK_REALTIME, &t) != 0)
+                    Clock_Error(Name());
+            }
+            static const char * Name() { return "realtime"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+            static inline uint64_t Get_Ticks()      { timespec t; Get_Time(t); return Timespec_To_Nanoseconds(t); }
+            static inline double Seconds_per_Tick() { return nanosec_to_sec; }
+            static inline void Initialize()         { }
+    };
+
+    // Time Stamp Counter (x86 only). Reading the TSC costs a single
+    // instruction; ticks are converted to seconds using a frequency
+    // calibrated against CLOCK_MONOTONIC (see Tsc.cpp). If the CPU
+    // does not have an invariant TSC, CLOCK_MONOTONIC is used instead.
+    extern bool   tsc_invariant;
+    extern double tsc_seconds_per_tick;
+    void Calibrate_TSC();
+
+    class Clock_TSC
+    {
+        public:
+            static inline void Get_Time(timespec &t)    { Clock_Monotonic::Get_Time(t); }
+            static inline uint64_t Get_Ticks()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                if (tsc_invariant)
+                    return __rdtsc();
+#endif // #if defined(__x86_64__) || defined(__i386__)
+                return Clock_Monotonic::Get_Ticks();
+            }
+            static inline double Seconds_per_Tick()     { return (tsc_invariant ? tsc_seconds_per_tick : nanosec_to_sec); }
+            static inline void Initialize()             { Calibrate_TSC(); }
+            static const char * Name() { return "tsc"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+    };
+
+    // Same as Clock_TSC but using "rdtscp" followed by "lfence": the
+    // counter is read only once all previous instructions completed
+    // and later instructions don't start before the read.
+    class Clock_TSC_Fenced
+    {
+        public:
+            static inline void Get_Time(timespec &t)    { Clock_Monotonic::Get_Time(t); }
+            static inline uint64_t Get_Ticks()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                if (tsc_invariant)
+                {
+                    unsigned int aux;
+                    const uint64_t ticks = __rdtscp(&aux);
+                    _mm_lfence();
+                    return ticks;
+                }
+#endif // #if defined(__x86_64__) || defined(__i386__)
+                return Clock_Monotonic::Get_Ticks();
+            }
+            static inline double Seconds_per_Tick()     { return (tsc_invariant ? tsc_seconds_per_tick : nanosec_to_sec); }
+            static inline void Initialize()             { Calibrate_TSC(); }
+            static const char * Name() { return "tsc fenced"; }
+            static inline bool Is_Wall_Clock()     { return true; }
+    };
+
     // **********************************************************
     class Clock
+    /**
+     * A time value (or duration) as a timespec. Values read from
+     * different clock sources share this type so their durations
+     * can be summed and reported together.
+     */
     {
         private:
             timespec timer;
@@ -124,45 +702,369 @@ namespace timing
             void Clear();
 
             std::string Get_Time() const;
+            size_t Format_Time(char *buffer, const size_t size) const;
             Clock operator+(const Clock &other);
             Clock operator-(const Clock &other);
             void Add_sec(time_t seconds);
             void Add_nsec(long nanseconds);
-            void Get_Current_Time();
+            template <class ClockSource>
+            inline void Get_Current_Time()          { ClockSource::Get_Time(timer); }
+            inline void Get_Current_Time()          { Get_Current_Time<Clock_Monotonic>(); }
             void Print() const;
     };
 
     // **********************************************************
-    class Timer
+    class Histogram
+    /**
+     * Log-bucketed (HDR-style) histogram of durations in ticks.
+     * Each power of two is split in 2^(precision_bits-1) linear
+     * sub-buckets, so a value is known within 1/2^(precision_bits-1)
+     * of itself. The buckets are allocated once; Record() is a few
+     * integer operations. Histograms with the same precision and
+     * clock source can be merged (threads, timers or runs).
+     */
     {
         private:
+            Histogram & operator=(const Histogram &other);
+
+        public:
+            int precision_bits;
+            int nb_buckets;
+            uint64_t *buckets;
+            uint64_t count;
+            uint64_t max;
+
+            Histogram(const int _precision_bits);
+            Histogram(const Histogram &other);
+            ~Histogram();
+
+            inline int Bucket_Index(const uint64_t value) const
+            {
+                const uint64_t nb_sub_buckets = uint64_t(1) << precision_bits;
+                if (value < nb_sub_buckets)
+                    return int(value);
+                const int msb   = 63 - __builtin_clzll(value);
+                const int shift = msb - precision_bits + 1;
+                return (shift << (precision_bits - 1)) + int(value >> shift);
+            }
+            inline void Record(const uint64_t value)
+            {
+                ++buckets[Bucket_Index(value)];
+                ++count;
+                if (value > max)
+                    max = value;
+            }
+            uint64_t Bucket_Lowest(const int index) const;
+            uint64_t Bucket_Highest(const int index) const;
+            uint64_t Percentile(const double percent) const;
+            size_t Footprint() const;
+            void Clear();
+            void Merge(const Histogram &other);
+            bool Save(const std::string &filename, const double seconds_per_tick) const;
+    };
+
+    // **********************************************************
+    class DurationStatistics
+    /**
+     * Streaming minimum, maximum, mean and variance of durations in
+     * ticks. Extremes are kept as integers; mean and variance use
+     * Welford's update, which stays accurate over billions of values.
+     * Constant time and no allocation, so it is always enabled.
+     */
+    {
+        public:
+            uint64_t count;
+            uint64_t min;
+            uint64_t max;
+            double   mean;
+            double   m2;        // Sum of squared differences from the mean
+
+            DurationStatistics();
+            inline void Record(const uint64_t ticks)
+            {
+                if (count == 0 or ticks < min)
+                    min = ticks;
+                if (ticks > max)
+                    max = ticks;
+                ++count;
+                const double delta = double(ticks) - mean;
+                mean += delta / double(count);
+                m2   += delta * (double(ticks) - mean);
+            }
+            void Clear();
+            void Merge(const DurationStatistics &other);
+            double Variance() const;
+    };
+
+    // **********************************************************
+    struct PerfCounts
+    /**
+     * Performance counters of a timer (or of one of its shards), see
+     * Enable_Perf_Counters().
+     */
+    {
+        uint64_t start[PERF_NB_EVENTS];     // Values at the last Start()
+        uint64_t total[PERF_NB_EVENTS];     // Sum of Stop() - Start()
+        uint64_t nb_calls;
+    };
+
+    // **********************************************************
+    struct ResourceUsage
+    /**
+     * getrusage(RUSAGE_THREAD) of a timer (or of one of its shards)
+     * between Start() and Stop(), measured on one timed call in
+     * "period", see Enable_Timers_Resource_Usage().
+     */
+    {
+        uint32_t period;
+        uint32_t countdown;                 // Calls until the next measured one
+        bool     is_measured;               // The current call is measured
+        uint64_t start[USAGE_NB_FIELDS];    // Values at the last measured Start()
+        uint64_t total[USAGE_NB_FIELDS];    // Sum of Stop() - Start()
+        uint64_t nb_calls;                  // Measured calls
+    };
+
+    // **********************************************************
+    struct AllocationCounts
+    /**
+     * Heap allocations of a timer (or of one of its shards), see
+     * Enable_Allocations().
+     */
+    {
+        uint64_t nb_calls;
+        uint64_t nb_allocations;    // malloc(), calloc(), realloc(), posix_memalign(), aligned_alloc(), new, new[]
+        uint64_t nb_frees;          // free(), realloc(), delete, delete[]
+        uint64_t bytes;             // Requested
+        uint64_t peak_live_bytes;   // Largest growth of the live heap during a call
+    };
+
+    // **********************************************************
+    struct Library_Allocations
+    /**
+     * While one exists, the calling thread's allocations and frees are
+     * the library's own and are not counted (see Enable_Allocations()).
+     */
+    {
+        Library_Allocations();
+        ~Library_Allocations();
+    };
+
+    // **********************************************************
+    class TimerShard
+    /**
+     * Per-thread state of a Timer when threaded mode is enabled.
+     * Only the owning thread writes to it, so Start() and Stop()
+     * don't need any lock or atomic operation.
+     */
+    {
+        public:
             bool is_started;
+            bool is_timed;              // False if sampling skipped this call
+            uint32_t sampling_countdown;
             uint64_t counter;
-            Clock start;
-            Clock end;
-            Clock duration;
-            Clock current_duration;
+            uint64_t start_ticks;
+            uint64_t duration_ticks;
+            uint64_t current_ticks;
+            DurationStatistics statistics;
+            Histogram *histogram;   // NULL if the timer has no histogram
+            PerfCounts *perf;       // NULL until counted
+            ResourceUsage *usage;   // NULL until measured
+            AllocationCounts *allocations;  // NULL until counted
 
-            // Used in output
+            TimerShard();
+            ~TimerShard();
+            template <class ClockSource>
+            inline void Stop()
+            {
+                if (is_started)
+                {
+                    is_started = false;
+                    if (not is_timed)
+                        return;
+
+                    current_ticks = ClockSource::Get_Ticks() - start_ticks;
+                    duration_ticks += current_ticks;
+                }
+            }
+    } __attribute__((aligned(TIMING_CACHE_LINE)));
+
+    // **********************************************************
+    struct FlightRecord
+    /**
+     * Compact binary record of a timer's Start()/Stop() pair.
+     */
+    {
+        uint32_t timer_id;
+        uint32_t reserved;
+        uint64_t start_ticks;
+        uint64_t duration_ticks;
+        uint64_t step;
+    };
+
+    // **********************************************************
+    class FlightRecorderRing
+    /**
+     * Fixed-size ring of the last records of a thread. Only the
+     * owning thread writes to it, so recording is a few stores.
+     * "position" counts all records ever written. It is published
+     * after each record is complete and before the next one starts,
+     * so a dump can tell the records it copied intact from those
+     * being rewritten.
+     */
+    {
+        public:
+            FlightRecord *records;
+            uint64_t mask;              // Number of records - 1 (power of two)
+            volatile uint64_t position;
+
+            FlightRecorderRing(const uint64_t nb_records);
+            ~FlightRecorderRing();
+
+            inline void Record(const uint32_t timer_id, const uint64_t start_ticks,
+                               const uint64_t duration_ticks, const uint64_t step)
+            {
+                const uint64_t current = position;
+                FlightRecord &record = records[current & mask];
+                record.timer_id       = timer_id;
+                record.reserved       = 0;
+                record.start_ticks    = start_ticks;
+                record.duration_ticks = duration_ticks;
+                record.step           = step;
+                // Compiler barrier: the record must be complete before it is published.
+                __asm__ __volatile__("" ::: "memory");
+                position = current + 1;
+                // Nor may the next record start before this one is published.
+                __asm__ __volatile__("" ::: "memory");
+            }
+    } __attribute__((aligned(TIMING_CACHE_LINE)));
+
+    void Flight_Recorder_Record(const uint32_t timer_id, const uint64_t start_ticks, const uint64_t duration_ticks);
+    void Flight_Recorder_Add_Timer(const Timer_Base &timer);
+
+    // **********************************************************
+    struct Timer_Overhead
+    /**
+     * Cost of an empty Start()/Stop() pair of a clock source, measured
+     * once when its first timer is created: "pair_seconds" is what the
+     * pair adds to the program and "bias_ticks" the part of it falling
+     * between the two clock reads, hence included in every duration.
+     */
+    {
+        double pair_seconds;
+        double bias_ticks;
+    };
+    template <class ClockSource>
+    const Timer_Overhead & Calibrate_Overhead();
+    void Print_Overhead(const char *s, const size_t longest_length);
+
+    // **********************************************************
+    class TimerCold
+    /**
+     * Part of a timer only used when it is created, reported or
+     * saved. Kept out of Timer_Base so Start()/Stop() stay on a
+     * single cache line.
+     */
+    {
+        public:
             std::string   name;
             std::string   output_filename;
             std::ofstream output_file;
             bool          output_has_been_performed;
+            uint64_t      output_dropped;   // Records dropped by the asynchronous writer
+            // Per-thread shards, indexed by Thread_Index(). Only used in threaded mode.
+            TimerShard   *shards[TIMING_MAX_THREADS];
+            // Cost of an empty Start()/Stop() pair (see Timer_Overhead)
+            double        overhead_pair_seconds;
+            double        overhead_bias_ticks;
+            PerfCounts   *perf;     // NULL until counted
+            // Measure the resource usage of one call in "usage_period" (0: never)
+            uint32_t      usage_period;
+            ResourceUsage *usage;   // NULL until measured
+            AllocationCounts *allocations;  // NULL until counted
+
+            TimerCold();
+            ~TimerCold();
+    };
+
+    // Features needing the out-of-line _Start()/_Stop()
+    enum Timers_Feature
+    {
+        FEATURE_OUTPUT          = 1,
+        FEATURE_CALL_PATH       = 2,
+        FEATURE_FLIGHT_RECORDER = 4,
+        FEATURE_TRACE           = 8,
+        FEATURE_PERF_COUNTERS   = 16,
+        FEATURE_ALLOCATIONS     = 64
+    };
+    // Timers_Feature flags currently enabled
+    extern uint32_t timers_features;
+
+    // **********************************************************
+    class Timer_Base
+    /**
+     * State and reporting of a timer, independent of its clock
+     * source. Start() and Stop() are provided by Basic_Timer.
+     */
+    {
+        protected:
+            // Hot state: everything the inline Start()/Stop() touch,
+            // in a single cache line. Raw ticks of the timer's clock
+            // source, converted to seconds only when queried.
+            uint64_t start_ticks __attribute__((aligned(TIMING_CACHE_LINE)));
+            uint64_t end_ticks;
+            uint64_t duration_ticks;
+            uint64_t current_ticks;
+            uint64_t counter;
+            // Distribution of the Start()/Stop() durations (NULL if disabled)
+            Histogram *histogram;
+            // Identifies the timer in compact records (flight recorder, ...)
+            uint32_t id;
+            // Time one call in "sampling_period" (0: every call)
+            uint32_t sampling_period;
+            uint32_t sampling_countdown;
+            // Flags, one bit each so they share the line's last byte
+            bool     is_started          : 1;
+            bool     is_threaded         : 1;
+            bool     is_timed            : 1;   // False if sampling skipped this call
+            bool     sampling_randomized : 1;
+            // This timer alone needs _Start()/_Stop() (resource usage)
+            bool     needs_slow_path     : 1;
+
+            // Updated by Stop(), on the next cache line
+            DurationStatistics statistics __attribute__((aligned(TIMING_CACHE_LINE)));
+
+            TimerCold *cold;
+
+            TimerShard & Local_Shard(const int thread_index);
+            TimerShard & New_Local_Shard(const int thread_index);
+            inline bool Sample_Now(uint32_t &countdown) const
+            {
+                if (--countdown != 0)
+                    return false;
+                countdown = Next_Sampling_Countdown(sampling_period, sampling_randomized);
+                return true;
+            }
+            void Write_Output();
 
         public:
-            Timer();
-            Timer(const Timer &other);
+            Timer_Base();
+            Timer_Base(const Timer_Base &other);
+            virtual ~Timer_Base();
             void Set_Name(const std::string &_full_name, const std::string &_strict_name);
+            const std::string & Get_Name() const;
+            const std::string & Get_Output_Filename() const;
+            virtual const char * Get_Clock_Name() const = 0;
+            virtual double Get_Seconds_per_Tick() const = 0;
             void Clear();
-            void Start();
-            void Stop();
+            // Stop() through the base class, for Stop_All_Timers().
+            // In threaded mode, stops every thread's shard.
+            virtual void Stop_Generic() = 0;
             uint64_t Get_Counter() const;
             void Add_Seconds(const double seconds);
             time_t Get_Duration_Seconds() const;
             long Get_Duration_NanoSeconds() const;
             double Get_Duration() const;
             double Get_Current_Duration() const;
-            void Update_Duration();
             uint64_t Duration_Years();
             uint64_t Duration_Days();
             uint64_t Duration_Hours();
@@ -170,13 +1072,301 @@ namespace timing
             uint64_t Duration_Seconds();
             std::string Duration_Human_Readable();
             void Print() const;
+            void Set_Threaded(const bool _is_threaded);
+            void Set_Id(const uint32_t _id);
+            uint32_t Get_Id() const;
+            bool Is_Threaded() const;
+            void Merge_Shards();
+            void Write_Output_Line(const uint64_t step, const uint64_t stop_realtime_ns, const uint64_t ticks);
+            void Flush_Output();
+            void Count_Dropped_Output();
+            uint64_t Get_Dropped_Output() const;
+            int  Thread_Statistics(double &min, double &max, double &mean) const;
+            void Enable_Histogram(const int precision_bits = 5);
+            void Disable_Histogram();
+            const Histogram * Get_Histogram() const;
+            double Get_Percentile(const double percent) const;
+            const DurationStatistics & Get_Statistics() const;
+            double Get_Min() const;
+            double Get_Max() const;
+            double Get_Mean() const;
+            double Get_Standard_Deviation() const;
+            void Set_Sampling(const uint32_t period, const bool randomized = false);
+            uint32_t Get_Sampling_Period() const;
+            bool Is_Sampled() const;
+            double Get_Estimated_Duration() const;
+            double Get_Estimated_Duration_Error() const;
+            void Set_Overhead(const Timer_Overhead &overhead);
+            double Get_Overhead_per_Call() const;
+            double Get_Overhead_Bias_per_Call() const;
+            double Get_Overhead() const;
+            double Get_Corrected_Duration() const;
+            bool Get_Perf_Counts(uint64_t counts[PERF_NB_EVENTS], uint64_t &nb_calls) const;
+            void Enable_Resource_Usage(const uint32_t period = 1);
+            void Disable_Resource_Usage();
+            bool Get_Resource_Usage(uint64_t usage[USAGE_NB_FIELDS], uint64_t &nb_calls) const;
+            bool Get_Allocations(AllocationCounts &total) const;
+            void Get_Live_Stats(Live_Stats_Timer &live) const;
+            void Get_Merged_Statistics(DurationStatistics &merged) const;
 
             // Stop_All_Timers() needs to reset TimerTotal's duration
             friend void Stop_All_Timers();
-            // New_Timer() acts as a constructor-like
-            friend Timer & New_Timer(const std::string &_name);
     };
 
+    // **********************************************************
+    template <class ClockSource = Clock_Monotonic>
+    class Basic_Timer : public Timer_Base
+    /**
+     * Timer reading its time from "ClockSource" (see Clock_Monotonic
+     * and friends). Member functions are instantiated in Timer.cpp
+     * for every clock source.
+     */
+    {
+        public:
+            Basic_Timer();
+            const char * Get_Clock_Name() const;
+            double Get_Seconds_per_Tick() const;
+            inline void Start();
+            inline void Stop();
+            void _Start();
+            void _Stop();
+            void Stop_Generic();
+            void Update_Duration();
+
+        protected:
+            // Start()/Stop() without any feature (see Calibrate_Overhead())
+            inline void Fast_Start();
+            inline void Fast_Stop();
+    };
+
+    // **********************************************************
+    template <class ClockSource>
+    inline void Basic_Timer<ClockSource>::Start()
+    /**
+     * Inlined in the caller. Threaded mode, call path, flight recorder
+     * and output go through _Start().
+     */
+    {
+        if (is_threaded or needs_slow_path or timers_features != 0)
+            _Start();
+        else
+            Fast_Start();
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    inline void Basic_Timer<ClockSource>::Fast_Start()
+    {
+        if (not is_started)
+        {
+            ++counter;
+            is_timed = (sampling_period == 0 or Sample_Now(sampling_countdown));
+            if (is_timed)
+                start_ticks = ClockSource::Get_Ticks();
+        }
+        is_started = true;
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    inline void Basic_Timer<ClockSource>::Stop()
+    /**
+     * Inlined in the caller; see Start().
+     */
+    {
+        if (is_threaded or needs_slow_path or timers_features != 0)
+            _Stop();
+        else
+            Fast_Stop();
+    }
+
+    // **********************************************************
+    template <class ClockSource>
+    inline void Basic_Timer<ClockSource>::Fast_Stop()
+    {
+        if (is_started)
+        {
+            is_started = false;
+            if (not is_timed)
+                return;
+
+            end_ticks = ClockSource::Get_Ticks();
+            current_ticks = end_ticks - start_ticks;
+            duration_ticks += current_ticks;
+
+            statistics.Record(current_ticks);
+            if (histogram != NULL)
+                histogram->Record(current_ticks);
+        }
+    }
+
+    typedef Basic_Timer<Clock_Monotonic> Timer;
+
+    // **********************************************************
+    template <class TimerType>
+    TimerType & Sampled(TimerType &timer, const uint32_t period, const bool randomized)
+    /**
+     * Used by TIMER_START_SAMPLED() to configure a timer when its
+     * static reference is initialized.
+     */
+    {
+        timer.Set_Sampling(period, randomized);
+        return timer;
+    }
+
+    // **********************************************************
+    struct Parallel_Thread_Slot
+    /**
+     * A thread's time inside the current instance of a parallel
+     * region. Each thread only writes its own cache line.
+     */
+    {
+        uint64_t generation;    // Instance of the region the slot belongs to
+        uint64_t enter_ticks;
+        uint64_t exit_ticks;
+        uint64_t busy_ticks;
+    } __attribute__((aligned(TIMING_CACHE_LINE)));
+
+    // **********************************************************
+    class Parallel_Region
+    /**
+     * Timer of a parallel region (OpenMP, thread pool) that also
+     * records the time each thread is busy inside it, between its
+     * Thread_Enter() and Thread_Exit(). A thread is waiting at the
+     * region's closing barrier from its Thread_Exit() to Stop().
+     * Start() and Stop() are called by a single thread, outside of
+     * the region. Durations are in Clock_Monotonic ticks.
+     */
+    {
+        public:
+            Timer   *timer;             // Wall time, printed with the other timers
+            uint64_t generation;        // Current instance
+            uint64_t start_ticks;
+
+            // Sums over the region's instances
+            uint64_t nb_instances;
+            int      max_nb_threads;
+            uint64_t thread_ticks;      // Number of threads times the wall time
+            uint64_t busy_ticks;
+            uint64_t busy_min_ticks;    // Least busy thread
+            uint64_t busy_max_ticks;    // Most busy thread
+            double   busy_mean_ticks;
+            uint64_t wait_ticks;        // At the closing barrier
+            uint64_t lost_ticks;        // Core time lost to imbalance
+
+            Parallel_Thread_Slot slots[TIMING_MAX_THREADS];
+
+            Parallel_Region(Timer &_timer);
+            void Clear();
+            void Start();
+            void Stop();
+            double Get_Efficiency() const;
+            double Get_Imbalance() const;
+            double Get_Lost_Core_Seconds() const;
+
+            // **************************************************
+            inline void Thread_Enter()
+            {
+                Parallel_Thread_Slot &slot = slots[Thread_Index()];
+                if (slot.generation != generation)
+                {
+                    slot.generation = generation;
+                    slot.busy_ticks = 0;
+                }
+                slot.enter_ticks = Clock_Monotonic::Get_Ticks();
+            }
+
+            // **************************************************
+            inline void Thread_Exit()
+            {
+                Parallel_Thread_Slot &slot = slots[Thread_Index()];
+                slot.exit_ticks  = Clock_Monotonic::Get_Ticks();
+                slot.busy_ticks += slot.exit_ticks - slot.enter_ticks;
+            }
+    };
+
+    // **********************************************************
+    class CallPathNode
+    /**
+     * Node of a thread's call-path tree. Each node is a timer
+     * reached through a specific chain of enclosing timers.
+     */
+    {
+        public:
+            const Timer_Base *timer;    // NULL for a thread's root
+            CallPathNode *parent;
+            std::vector<CallPathNode *> children;
+            uint64_t counter;
+            uint64_t inclusive_ticks;
+
+            CallPathNode(const Timer_Base *_timer, CallPathNode *_parent);
+            ~CallPathNode();
+            CallPathNode * Child(const Timer_Base *_timer);
+            const char * Get_Name() const;
+            bool Is_Sampled() const;
+            double Get_Sampling_Factor() const;
+            double Get_Calls() const;
+            double Get_Inclusive() const;
+            double Get_Children_Inclusive() const;
+    };
+
+    // **********************************************************
+    class Aggregation_Transport
+    /**
+     * How timing::Print() gathers the timers of every process (rank)
+     * of a job on rank 0. See File_Transport and MPI_Transport.
+     */
+    {
+        public:
+            virtual ~Aggregation_Transport() {}
+            virtual int Rank() const = 0;
+            virtual int Nb_Ranks() const = 0;
+            // Rank 0 gets every rank's "local" in "all" (indexed by rank,
+            // empty for a rank that did not report); other ranks get nothing.
+            virtual void Gather(const std::string &local, std::vector<std::string> &all) = 0;
+    };
+
+    // **********************************************************
+    class File_Transport : public Aggregation_Transport
+    /**
+     * Every rank writes its timers to a file in a folder shared by the
+     * processes (a local or network file system, or /dev/shm to stay in
+     * memory on a single node) and rank 0 reads them. No MPI needed.
+     */
+    {
+        private:
+            std::string folder;
+            int rank;
+            int nb_ranks;
+            double timeout;     // Seconds rank 0 waits for the other ranks
+
+        public:
+            File_Transport(const std::string &_folder, const int _rank = -1, const int _nb_ranks = -1,
+                           const double _timeout = 60.0);
+            int Rank() const;
+            int Nb_Ranks() const;
+            void Gather(const std::string &local, std::vector<std::string> &all);
+    };
+
+#ifdef PARALLEL_MPI
+    // **********************************************************
+    class MPI_Transport : public Aggregation_Transport
+    /**
+     * Gather on rank 0 of "communicator". Every rank must call
+     * timing::Print().
+     */
+    {
+        private:
+            MPI_Comm communicator;
+
+        public:
+            MPI_Transport(MPI_Comm _communicator = MPI_COMM_WORLD);
+            int Rank() const;
+            int Nb_Ranks() const;
+            void Gather(const std::string &local, std::vector<std::string> &all);
+    };
+#endif // #ifdef PARALLEL_MPI
+
     // **********************************************************
     class Eta
     {
@@ -199,6 +1389,106 @@ namespace timing
 #endif // #ifndef DISABLE_TIMING
     };
 
+    size_t Format_Duration(const double seconds, char *buffer, const size_t size);
+
+    // How Eta_Estimator predicts the cost of the remaining progress
+    enum Eta_Model
+    {
+        ETA_AVERAGE,        // Average since the first update
+        ETA_EXPONENTIAL,    // Exponentially weighted average ("parameter": weight of an update, 0.05)
+        ETA_WINDOW,         // Average of the last updates ("parameter": number of updates, 64)
+        ETA_PHASE           // Average since the last New_Phase()
+    };
+    // Largest window of ETA_WINDOW
+    const int eta_max_window = 128;
+
+    // **********************************************************
+    struct Eta_Cost
+    /**
+     * Mean and variance of the seconds per unit of progress of
+     * updates, weighted by their progress.
+     */
+    {
+        double weight;
+        double mean;
+        double m2;
+        uint64_t count;
+
+        inline void Clear()
+        {
+            weight = 0.0;
+            mean   = 0.0;
+            m2     = 0.0;
+            count  = 0;
+        }
+        inline void Record(const double cost, const double progress)
+        {
+            weight += progress;
+            const double delta = cost - mean;
+            mean  += (progress / weight) * delta;
+            m2    += progress * delta * (cost - mean);
+            count++;
+        }
+    };
+
+    // **********************************************************
+    class Eta_Estimator
+    /**
+     * Estimated time to go from "first" to "last" progress (steps,
+     * simulation time, ...), with a 95% confidence band. Update()
+     * feeds every model at constant cost, so the model can be changed
+     * at any time; neither Update() nor the queries allocate memory.
+     */
+    {
+        private:
+            double first;
+            double last;
+            Eta_Model model;
+            double parameter;
+
+            double   progress;          // Last Update()
+            uint64_t progress_ticks;    // Clock_Monotonic at the last progress
+
+            Eta_Cost average;
+            Eta_Cost phase;
+            double   exponential_alpha;     // Weight of an update, fixed until changed by Set_Model()
+            double   exponential_mean;
+            double   exponential_variance;
+            uint64_t exponential_count;
+            double   window_seconds[eta_max_window];
+            double   window_progress[eta_max_window];
+            int      window_position;
+            int      window_count;
+
+            void _Update(const double _progress);
+            bool _Estimate(double &remaining, double &low, double &high) const;
+            size_t _Format(char *buffer, const size_t size) const;
+
+        public:
+            Eta_Estimator(const double _first, const double _last, const Eta_Model _model = ETA_EXPONENTIAL, const double _parameter = 0.0);
+            void Set_Model(const Eta_Model _model, const double _parameter = 0.0);
+            void New_Phase();
+#ifndef DISABLE_TIMING
+            inline void Update(const double _progress)  { _Update(_progress); }
+            inline bool Estimate(double &remaining, double &low, double &high) const
+                                                        { return _Estimate(remaining, low, high); }
+            inline size_t Format(char *buffer, const size_t size) const
+                                                        { return _Format(buffer, size); }
+#else // #ifndef DISABLE_TIMING
+            inline void Update(const double _progress)  { /* Don't do anything */ }
+            inline bool Estimate(double &remaining, double &low, double &high) const
+                                                        { return false; }
+            inline size_t Format(char *buffer, const size_t size) const
+                                                        { return (size_t) snprintf(buffer, size, "-"); }
+#endif // #ifndef DISABLE_TIMING
+    };
+
+    // Number of recent timesteps remembered by TimestepTiming
+    const int timestep_window = 64;
+    // Called by TimestepTiming when timestep "t" took "seconds", more
+    // than its factor times the "median" of the recent timesteps
+    typedef void (*Stall_Callback)(const uint64_t t, const double seconds, const double median, void *data);
+
     // **********************************************************
     class TimestepTiming
     {
@@ -208,7 +1498,21 @@ namespace timing
             uint64_t prev_t, nb_timesteps;
             double prev_duration;
 
+            // Ring of the last timesteps and when they were reached (Clock_Monotonic)
+            uint64_t window_timesteps[timestep_window];
+            uint64_t window_ticks[timestep_window];
+            int      window_position;
+            int      window_count;
+
+            Stall_Callback stall_callback;
+            void    *stall_data;
+            double   stall_factor;
+            uint64_t nb_stalls;
+
             void    Update(const uint64_t t);
+            void    Detect_Stall();
+            int     Window_Durations(double durations[timestep_window]) const;
+            bool    _Window_Statistics(double &timesteps_per_second, double &jitter, double &slowest) const;
             double _Seconds_per_Timestep(const uint64_t t);
             double _Timesteps_per_Second(const uint64_t t);
             std::string _Timesteps_per_Second_String(const uint64_t t, const int width = 0, const char fill = ' ');
@@ -216,7 +1520,12 @@ namespace timing
 
         public:
             TimestepTiming();
+            void Set_Stall_Callback(Stall_Callback callback, const double factor = 5.0, void *data = NULL);
+            uint64_t Nb_Stalls() const { return nb_stalls; }
 #ifndef DISABLE_TIMING
+            inline void Set_Timestep(const uint64_t t)                              { Update(t); }
+            inline bool Window_Statistics(double &timesteps_per_second, double &jitter, double &slowest) const
+                                                                                    { return _Window_Statistics(timesteps_per_second, jitter, slowest); }
             inline double Seconds_per_Timestep(const uint64_t t, const double time) { return _Seconds_per_Timestep(t); }
             inline double Seconds_per_Timestep(const uint64_t t)                    { return _Seconds_per_Timestep(t); }
             inline double Timesteps_per_Second(const uint64_t t, const double time) { return _Timesteps_per_Second(t); }
@@ -226,6 +1535,9 @@ namespace timing
             inline std::string Total_Timesteps_per_Second_String(const uint64_t tmax, const int width = 0, const char fill = ' ')
                                                                                     { return _Total_Timesteps_per_Second_String(tmax, width, fill); }
 #else // #ifndef DISABLE_TIMING
+            inline void Set_Timestep(const uint64_t t)                              { /* Don't do anything */                }
+            inline bool Window_Statistics(double &timesteps_per_second, double &jitter, double &slowest) const
+                                                                                    { return false; }
             inline double Seconds_per_Timestep(const uint64_t t, const double time) { /* Don't do anything */                }
             inline double Seconds_per_Timestep(const uint64_t t)                    { /* Don't do anything */                }
             inline double Timesteps_per_Second(const uint64_t t, const double time) { /* Don't do anything */                }
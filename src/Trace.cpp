@@ -0,0 +1,345 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <cstdlib>
+#include <cstring>    // memset()
+#include <new>        // Placement new
+#include <pthread.h>  // pthread_mutex_t
+#include <unistd.h>   // getpid()
+
+/**
+ * The trace is a Chrome Trace Event JSON file ("JSON object format"),
+ * opened by Perfetto (ui.perfetto.dev) and chrome://tracing:
+ *
+ *   {"displayTimeUnit":"ns","traceEvents":[
+ *   {"name":"process_name","ph":"M","pid":1234,"args":{"name":"..."}},
+ *   {"name":"thread_name","ph":"M","pid":1234,"tid":0,"args":{"name":"thread 0"}},
+ *   {"name":"timer","cat":"timer","ph":"X","pid":1234,"tid":0,"ts":12.345,"dur":6.789,"args":{"step":0}},
+ *   {"name":"step 1","cat":"step","ph":"i","s":"p","pid":1234,"tid":0,"ts":20.000},
+ *   ...
+ *   ]}
+ *
+ * Each timer's Start()/Stop() is a complete ("X") event on the track of
+ * the thread (Thread_Index()) that stopped it, so nested timers are
+ * drawn nested. "ts" is in microseconds since Enable_Trace() and the
+ * process is the operating system's process id. Set_Timers_Step() adds
+ * an instant ("i") event spanning the process' tracks. Timers of CPU
+ * time clocks (Clock_Thread_CPU, Clock_Process_CPU) are not traced:
+ * their durations can't be placed on the wall-clock timeline.
+ */
+
+namespace timing
+{
+    extern uint64_t timers_step;
+    void Initialize_Timers_Storage();
+
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // Write Start()/Stop() pairs to a trace file
+    bool trace_enabled = false;
+    // Number of events buffered by each new thread before it writes them
+    uint64_t trace_nb_events = 0;
+    // CLOCK_MONOTONIC when the trace was opened (nanoseconds)
+    uint64_t trace_origin_ns = 0;
+    FILE *trace_file = NULL;
+    pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+    int trace_pid = 0;
+
+    // Size of the buffer events are formatted in before being written
+    const size_t trace_chunk_size = 65536;
+    // Longest formatted event, excluding the timer's name
+    const size_t trace_event_size = 256;
+
+    // Kinds of TraceEvent
+    const uint32_t trace_interval = 0;
+    const uint32_t trace_step     = 1;
+
+    // **********************************************************
+    struct TraceEvent
+    {
+        uint32_t timer_id;
+        uint32_t type;
+        uint64_t end_ns;            // CLOCK_MONOTONIC
+        uint64_t duration_ticks;    // In the timer's clock
+        uint64_t step;
+    };
+
+    // **********************************************************
+    class TraceBuffer
+    /**
+     * Events of a thread not yet written to the trace.
+     */
+    {
+        public:
+            TraceEvent *events;
+            uint64_t capacity;
+            uint64_t nb_events;
+            int thread_index;
+
+            TraceBuffer(const uint64_t _capacity, const int _thread_index)
+            {
+                events       = new TraceEvent[_capacity];
+                capacity     = _capacity;
+                nb_events    = 0;
+                thread_index = _thread_index;
+            }
+            ~TraceBuffer()
+            {
+                Library_Allocations library;
+                delete[] events;
+            }
+    } __attribute__((aligned(TIMING_CACHE_LINE)));
+
+    // Buffer of each thread, indexed by Thread_Index()
+    TraceBuffer *trace_buffers[TIMING_MAX_THREADS];
+    // Calling thread's buffer (NULL until its first event)
+    __thread TraceBuffer *trace_buffer = NULL;
+
+    // **********************************************************
+    size_t Append_Escaped(char *output, const size_t size, const std::string &text)
+    /**
+     * Copy "text" into "output" as the inside of a JSON string.
+     * Return the number of characters written (at most size-1).
+     */
+    {
+        size_t length = 0;
+        for (size_t i = 0 ; i < text.length() and length + 7 < size ; i++)
+        {
+            const unsigned char c = (unsigned char) text[i];
+            if (c == '"' or c == '\\')
+            {
+                output[length++] = '\\';
+                output[length++] = char(c);
+            }
+            else if (c < 0x20)
+                length += size_t(snprintf(output + length, size - length, "\\u%04x", (unsigned int) c));
+            else
+                output[length++] = char(c);
+        }
+        output[length] = '\0';
+        return length;
+    }
+
+    // **********************************************************
+    void Write_Trace_Events(const TraceBuffer &buffer)
+    /**
+     * Format "buffer"'s events and append them to the trace. The
+     * trace's lock must be held.
+     */
+    {
+        char chunk[trace_chunk_size];
+        size_t length = 0;
+
+        for (uint64_t i = 0 ; i < buffer.nb_events ; i++)
+        {
+            const TraceEvent &event = buffer.events[i];
+            if (length + trace_event_size + trace_chunk_size/4 > trace_chunk_size)
+            {
+                fwrite(chunk, 1, length, trace_file);
+                length = 0;
+            }
+
+            const double end_us = double(event.end_ns - trace_origin_ns) * 1.0e-3;
+            if (event.type == trace_step)
+            {
+                length += size_t(snprintf(chunk + length, trace_chunk_size - length,
+                    ",\n{\"name\":\"step %" PRIu64 "\",\"cat\":\"step\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    (uint64_t) event.step, trace_pid, buffer.thread_index, end_us));
+                continue;
+            }
+
+            const Timer_Base &timer = Get_Timer(event.timer_id);
+            const double duration_us = double(event.duration_ticks) * timer.Get_Seconds_per_Tick() * 1.0e6;
+            length += size_t(snprintf(chunk + length, trace_chunk_size - length, ",\n{\"name\":\""));
+            length += Append_Escaped(chunk + length, trace_chunk_size/4, timer.Get_Name());
+            length += size_t(snprintf(chunk + length, trace_chunk_size - length,
+                "\",\"cat\":\"timer\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%" PRIu64 "}}",
+                trace_pid, buffer.thread_index, std::max(0.0, end_us - duration_us), duration_us,
+                (uint64_t) event.step));
+        }
+        fwrite(chunk, 1, length, trace_file);
+    }
+
+    // **********************************************************
+    void Flush_Trace_Buffer(TraceBuffer &buffer)
+    {
+        pthread_mutex_lock(&trace_mutex);
+        if (trace_file != NULL)
+            Write_Trace_Events(buffer);
+        buffer.nb_events = 0;
+        pthread_mutex_unlock(&trace_mutex);
+    }
+
+    // **********************************************************
+    TraceBuffer & Local_Trace_Buffer()
+    {
+        TraceBuffer *buffer = trace_buffer;
+        if (buffer == NULL)
+            buffer = trace_buffer = trace_buffers[Thread_Index()];
+        if (buffer == NULL)
+        {
+            Library_Allocations library;
+            const int index = Thread_Index();
+            void *memory = NULL;
+            if (posix_memalign(&memory, TIMING_CACHE_LINE, sizeof(TraceBuffer)) != 0)
+            {
+                log("ERROR: Could not allocate trace buffer for thread %d!\n", index);
+                abort();
+            }
+            buffer = new (memory) TraceBuffer(trace_nb_events, index);
+            trace_buffers[index] = buffer;
+            trace_buffer = buffer;
+
+            pthread_mutex_lock(&trace_mutex);
+            if (trace_file != NULL)
+                fprintf(trace_file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                        trace_pid, index, index);
+            pthread_mutex_unlock(&trace_mutex);
+        }
+        return *buffer;
+    }
+
+    // **********************************************************
+    inline void Push_Trace_Event(const uint32_t timer_id, const uint32_t type, const uint64_t duration_ticks, const uint64_t step)
+    {
+        TraceBuffer &buffer = Local_Trace_Buffer();
+        TraceEvent &event = buffer.events[buffer.nb_events];
+        event.timer_id       = timer_id;
+        event.type           = type;
+        event.end_ns         = Clock_Monotonic::Get_Ticks();
+        event.duration_ticks = duration_ticks;
+        event.step           = step;
+        if (++buffer.nb_events == buffer.capacity)
+            Flush_Trace_Buffer(buffer);
+    }
+
+    // **********************************************************
+    void Enable_Trace(const std::string &filename, const uint64_t nb_events_per_thread)
+    /**
+     * Write every Start()/Stop() pair to "filename" as a Chrome Trace
+     * Event file (see above). Each thread buffers "nb_events_per_thread"
+     * events (32 bytes each) and appends them to the file when its
+     * buffer is full, so memory does not grow with the trace. The file
+     * is completed by Close_Trace(), at the program's exit.
+     * If used, _must_ be called _before_ any TIMER_START().
+     */
+    {
+        Close_Trace();
+
+        trace_file = fopen(filename.c_str(), "w");
+        if (trace_file == NULL)
+        {
+            log("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+            return;
+        }
+
+        trace_nb_events = std::max(uint64_t(1), nb_events_per_thread);
+        trace_origin_ns = Clock_Monotonic::Get_Ticks();
+        trace_pid       = int(getpid());
+
+        char program[256] = "timing";
+        FILE *comm = fopen("/proc/self/comm", "r");
+        if (comm != NULL)
+        {
+            if (fgets(program, sizeof(program), comm) != NULL)
+                program[strcspn(program, "\n")] = '\0';
+            fclose(comm);
+        }
+        char escaped[sizeof(program) * 6];
+        Append_Escaped(escaped, sizeof(escaped), program);
+        fprintf(trace_file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s (%d)\"}}",
+                trace_pid, escaped, trace_pid);
+
+        trace_enabled = true;
+        timers_features |= FEATURE_TRACE;
+
+        // Complete the file at exit.
+        static bool close_at_exit = false;
+        if (not close_at_exit)
+        {
+            Initialize_Timers_Storage();
+            atexit(Close_Trace);
+            close_at_exit = true;
+        }
+    }
+
+    // **********************************************************
+    bool Trace_Enabled()
+    {
+        return trace_enabled;
+    }
+
+    // **********************************************************
+    void Trace_Record(const uint32_t timer_id, const uint64_t duration_ticks)
+    /**
+     * Add a Start()/Stop() pair ending now to the calling thread's buffer.
+     */
+    {
+        // Timers outside the timers table (TimerTotal) have no name.
+        if (timer_id == invalid_timer_id)
+            return;
+        Push_Trace_Event(timer_id, trace_interval, duration_ticks, timers_step);
+    }
+
+    // **********************************************************
+    void Trace_Step(const uint64_t step)
+    {
+        if (trace_enabled)
+            Push_Trace_Event(invalid_timer_id, trace_step, 0, step);
+    }
+
+    // **********************************************************
+    void Flush_Trace()
+    /**
+     * Write the events still buffered by every thread, leaving the
+     * trace open. The other threads must not be using timers.
+     */
+    {
+        pthread_mutex_lock(&trace_mutex);
+        if (trace_file != NULL)
+        {
+            for (int i = 0 ; i < TIMING_MAX_THREADS ; i++)
+            {
+                if (trace_buffers[i] == NULL)
+                    continue;
+                Write_Trace_Events(*trace_buffers[i]);
+                trace_buffers[i]->nb_events = 0;
+            }
+            fflush(trace_file);
+        }
+        pthread_mutex_unlock(&trace_mutex);
+    }
+
+    // **********************************************************
+    void Close_Trace()
+    /**
+     * Write the events still buffered by every thread and complete
+     * the trace. The other threads must not be using timers.
+     */
+    {
+        if (trace_file == NULL)
+            return;
+
+        trace_enabled = false;
+        timers_features &= ~uint32_t(FEATURE_TRACE);
+
+        Flush_Trace();
+        pthread_mutex_lock(&trace_mutex);
+        fprintf(trace_file, "\n]}\n");
+        fclose(trace_file);
+        trace_file = NULL;
+        pthread_mutex_unlock(&trace_mutex);
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
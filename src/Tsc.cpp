@@ -0,0 +1,129 @@
+#include "Timing.hpp"
+
+// See https://github.com/nbigaouette/stdcout
+#ifdef USE_STDCOUT
+// If stdcout.git is wanted, include it.
+#include <StdCout.hpp>
+#else
+// If stdcout.git is not wanted, define log() as being printf().
+#define log printf
+#endif // #ifdef USE_STDCOUT
+
+#include <pthread.h> // pthread_once()
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>   // __get_cpuid()
+#endif // #if defined(__x86_64__) || defined(__i386__)
+
+namespace timing
+{
+    // **********************************************************
+    // Variables global to the library but hidden from program
+
+    // True once the TSC was found invariant and calibrated
+    bool     tsc_invariant        = false;
+    double   tsc_seconds_per_tick = nanosec_to_sec;
+    // True once a TSC clock source was initialized
+    bool     tsc_initialized      = false;
+    // Reference point of the calibration, used to refine it at report time
+    uint64_t tsc_reference_ticks  = 0;
+    uint64_t tsc_reference_ns     = 0;
+    pthread_once_t tsc_once       = PTHREAD_ONCE_INIT;
+
+    // Duration of the startup calibration (nanoseconds)
+    const uint64_t tsc_calibration_ns = 10000000; // 10 ms
+
+    // **********************************************************
+    bool TSC_Is_Invariant()
+    /**
+     * An invariant TSC runs at a constant rate in all ACPI P-, C-
+     * and T-states (CPUID leaf 0x80000007, EDX bit 8).
+     */
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 or eax < 0x80000007)
+            return false;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+            return false;
+        return ((edx & (1u << 8)) != 0);
+#else // #if defined(__x86_64__) || defined(__i386__)
+        return false;
+#endif // #if defined(__x86_64__) || defined(__i386__)
+    }
+
+    // **********************************************************
+    void Calibrate_TSC_Once()
+    {
+        tsc_initialized = true;
+
+        if (not TSC_Is_Invariant())
+            return;
+
+#if defined(__x86_64__) || defined(__i386__)
+        // Busy wait so the TSC and CLOCK_MONOTONIC are read close together.
+        const uint64_t start_ns    = Clock_Monotonic::Get_Ticks();
+        const uint64_t start_ticks = __rdtsc();
+        uint64_t end_ns = start_ns;
+        while (end_ns - start_ns < tsc_calibration_ns)
+        {
+            end_ns = Clock_Monotonic::Get_Ticks();
+        }
+        const uint64_t end_ticks = __rdtsc();
+
+        tsc_reference_ns     = start_ns;
+        tsc_reference_ticks  = start_ticks;
+        tsc_seconds_per_tick = double(end_ns - start_ns) * nanosec_to_sec / double(end_ticks - start_ticks);
+        // Set last: Clock_TSC::Get_Ticks() reads the TSC from now on.
+        tsc_invariant        = true;
+#endif // #if defined(__x86_64__) || defined(__i386__)
+    }
+
+    // **********************************************************
+    void Calibrate_TSC()
+    /**
+     * Detect an invariant TSC and calibrate its frequency against
+     * CLOCK_MONOTONIC. Only done once, when the first TSC timer is
+     * created. Falls back to CLOCK_MONOTONIC if the TSC is not invariant.
+     */
+    {
+        pthread_once(&tsc_once, Calibrate_TSC_Once);
+    }
+
+    // **********************************************************
+    void Refine_TSC_Calibration()
+    /**
+     * Recompute the TSC frequency over the whole run, which is far
+     * more precise than the short startup calibration. Called once
+     * at the start of every report, before any tick is converted.
+     */
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (not tsc_invariant)
+            return;
+
+        const uint64_t now_ns    = Clock_Monotonic::Get_Ticks();
+        const uint64_t now_ticks = __rdtsc();
+        if (now_ns - tsc_reference_ns > 10*tsc_calibration_ns)
+            tsc_seconds_per_tick = double(now_ns - tsc_reference_ns) * nanosec_to_sec / double(now_ticks - tsc_reference_ticks);
+#endif // #if defined(__x86_64__) || defined(__i386__)
+    }
+
+    // **********************************************************
+    void Print_TSC_Information()
+    /**
+     * Report which clock backend the TSC timers used and the
+     * frequency the report's durations were converted with.
+     */
+    {
+        if (not tsc_initialized)
+            return;
+
+        if (tsc_invariant)
+            Report("TSC timers: invariant TSC calibrated at %.6f GHz\n", 1.0e-9 / tsc_seconds_per_tick);
+        else
+            Report("TSC timers: TSC not invariant, CLOCK_MONOTONIC (clock_gettime) was used instead\n");
+        Report("\n");
+    }
+} // namespace timing
+
+// ********** End of file ***************************************
@@ -0,0 +1,369 @@
+/**
+ * timing-top: follow the timers of a running program.
+ *
+ * The program publishes its timers with TIMERS_ENABLE_LIVE_STATS()
+ * (see timing::Enable_Live_Stats()) to /dev/shm/timing.<pid>;
+ * timing-top maps that file and shows, every interval, what each
+ * timer did since the previous refresh.
+ *
+ * Build (only the header is needed):
+ *   g++ -O2 -Isrc tools/Timing_Top.cpp -o timing-top
+ *
+ * Usage:
+ *   timing-top [-i seconds] [-s time|calls|mean|name] [-n refreshes] [-b] [pid|file]
+ *
+ * Without pid or file, the most recent /dev/shm/timing.* is used.
+ * While running, press t, c, m or n to sort by time, calls, mean
+ * duration or name, and q to quit. -b (batch) prints each refresh
+ * one after the other instead of redrawing the terminal.
+ */
+
+#include <Timing.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>     // opendir()
+#include <fcntl.h>      // open()
+#include <signal.h>     // kill()
+#include <sys/mman.h>   // mmap()
+#include <sys/select.h> // select()
+#include <sys/stat.h>   // fstat()
+#include <termios.h>
+#include <unistd.h>
+
+// **************************************************************
+struct Snapshot
+{
+    timing::Live_Stats_Header header;
+    std::vector<timing::Live_Stats_Timer> timers;
+};
+
+// **************************************************************
+struct Row
+{
+    const char *name;
+    uint64_t calls;         // In the interval
+    double seconds;         // In the interval
+    double last_seconds;
+    uint64_t total_calls;
+    double total_seconds;
+};
+
+// Sort keys
+enum Sort_Key
+{
+    SORT_TIME,
+    SORT_CALLS,
+    SORT_MEAN,
+    SORT_NAME
+};
+Sort_Key sort_key = SORT_TIME;
+
+termios original_terminal;
+bool terminal_changed = false;
+
+// **************************************************************
+bool Compare_Rows(const Row &a, const Row &b)
+{
+    switch (sort_key)
+    {
+        case SORT_CALLS:
+            return a.calls > b.calls;
+        case SORT_MEAN:
+            return (a.calls == 0 ? 0.0 : a.seconds / double(a.calls)) > (b.calls == 0 ? 0.0 : b.seconds / double(b.calls));
+        case SORT_NAME:
+            return strcmp(a.name, b.name) < 0;
+        default:
+            return a.seconds > b.seconds;
+    }
+}
+
+// **************************************************************
+const char * Sort_Name()
+{
+    const char *names[] = {"time", "calls", "mean", "name"};
+    return names[sort_key];
+}
+
+// **************************************************************
+std::string Find_Live_Stats_File()
+/**
+ * Most recently modified /dev/shm/timing.* file.
+ */
+{
+    const std::string prefix(timing::live_stats_prefix);
+    const std::string folder = prefix.substr(0, prefix.rfind('/') + 1);
+    const std::string basename = prefix.substr(folder.length());
+
+    std::string newest;
+    time_t newest_time = 0;
+    DIR *directory = opendir(folder.c_str());
+    if (directory == NULL)
+        return newest;
+    dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strncmp(entry->d_name, basename.c_str(), basename.length()) != 0)
+            continue;
+        const std::string path = folder + entry->d_name;
+        struct stat status;
+        if (stat(path.c_str(), &status) == 0 and (newest.empty() or status.st_mtime > newest_time))
+        {
+            newest      = path;
+            newest_time = status.st_mtime;
+        }
+    }
+    closedir(directory);
+    return newest;
+}
+
+// **************************************************************
+bool Read_Snapshot(const char *memory, const size_t size, Snapshot &snapshot)
+/**
+ * Copy the file between two equal and even sequence numbers, so
+ * the copy is never torn by the program's updates.
+ */
+{
+    const timing::Live_Stats_Header *header = reinterpret_cast<const timing::Live_Stats_Header *>(memory);
+    const timing::Live_Stats_Timer *timers = reinterpret_cast<const timing::Live_Stats_Timer *>(header + 1);
+    const size_t max_nb_timers = (size - sizeof(timing::Live_Stats_Header)) / sizeof(timing::Live_Stats_Timer);
+
+    for (int attempt = 0 ; attempt < 1000 ; attempt++)
+    {
+        const uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        if (sequence % 2 == 1)
+        {
+            usleep(100);
+            continue;
+        }
+        memcpy(&snapshot.header, header, sizeof(timing::Live_Stats_Header));
+        const size_t nb_timers = std::min(size_t(snapshot.header.nb_timers), max_nb_timers);
+        snapshot.timers.resize(nb_timers);
+        if (nb_timers != 0)
+            memcpy(&snapshot.timers[0], timers, nb_timers * sizeof(timing::Live_Stats_Timer));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->sequence, __ATOMIC_RELAXED) == sequence)
+        {
+            snapshot.header.nb_timers = uint32_t(nb_timers);
+            return true;
+        }
+    }
+    return false;
+}
+
+// **************************************************************
+void Print_Snapshot(const std::string &filename, const Snapshot &previous, const Snapshot &current, const bool batch)
+{
+    const double interval = double(current.header.update_ns - previous.header.update_ns) * 1.0e-9;
+
+    std::vector<Row> rows;
+    size_t longest_length = 5;
+    for (size_t i = 0 ; i < current.timers.size() ; i++)
+    {
+        const timing::Live_Stats_Timer &timer = current.timers[i];
+        Row row;
+        row.name          = timer.name;
+        row.calls         = timer.calls;
+        row.seconds       = timer.seconds;
+        row.last_seconds  = timer.last_seconds;
+        row.total_calls   = timer.calls;
+        row.total_seconds = timer.seconds;
+        if (i < previous.timers.size())
+        {
+            row.calls   -= std::min(row.calls, previous.timers[i].calls);
+            row.seconds -= std::min(row.seconds, previous.timers[i].seconds);
+        }
+        rows.push_back(row);
+        longest_length = std::max(longest_length, strlen(timer.name));
+    }
+    std::sort(rows.begin(), rows.end(), Compare_Rows);
+
+    if (not batch)
+        printf("\033[H\033[2J");
+
+    const bool is_running = (kill(pid_t(current.header.pid), 0) == 0);
+    const double step_rate = (interval <= 0.0 ? 0.0 : double(current.header.step - std::min(current.header.step, previous.header.step)) / interval);
+    const uint64_t elapsed = uint64_t(current.header.elapsed_seconds);
+    printf("timing-top  pid %" PRId64 " (%s)  %s\n", (int64_t) current.header.pid, filename.c_str(),
+           (current.header.is_finished ? "finished" : (is_running ? "running" : "not running")));
+    printf("elapsed %02" PRIu64 ":%02" PRIu64 ":%02" PRIu64 "  step %" PRIu64 "  steps/s %.4g (TimestepTiming %.4g)  interval %.3g s  sort: %s\n\n",
+           (uint64_t) (elapsed / 3600), (uint64_t) (elapsed / 60 % 60), (uint64_t) (elapsed % 60),
+           (uint64_t) current.header.step, step_rate, current.header.timesteps_per_second, interval, Sort_Name());
+
+    std::string name("Timer");
+    name.resize(longest_length, ' ');
+    printf("%s |   Calls    |  Time (s)  | %% interval |  Mean (s)  |  Last (s)  | Total calls|  Total (s) \n", name.c_str());
+    for (size_t i = 0 ; i < rows.size() ; i++)
+    {
+        const Row &row = rows[i];
+        name = row.name;
+        name.resize(longest_length, ' ');
+        printf("%s | %10" PRIu64 " | %10.4g | %10.2f | %10.4g | %10.4g | %10" PRIu64 " | %10.4g\n", name.c_str(),
+               (uint64_t) row.calls,
+               row.seconds,
+               (interval <= 0.0 ? 0.0 : row.seconds / interval * 100.0),
+               (row.calls == 0 ? 0.0 : row.seconds / double(row.calls)),
+               row.last_seconds,
+               (uint64_t) row.total_calls,
+               row.total_seconds);
+    }
+    if (not batch)
+        printf("\n[t]ime [c]alls [m]ean [n]ame [q]uit\n");
+    else
+        printf("\n");
+    fflush(stdout);
+}
+
+// **************************************************************
+void Restore_Terminal()
+{
+    if (terminal_changed)
+        tcsetattr(STDIN_FILENO, TCSANOW, &original_terminal);
+}
+
+// **************************************************************
+bool Wait_For_Key(const double seconds, const bool interactive)
+/**
+ * Wait "seconds", handling the keys pressed meanwhile. Return false
+ * to quit.
+ */
+{
+    if (not interactive)
+    {
+        usleep(useconds_t(seconds * 1.0e6));
+        return true;
+    }
+
+    timeval timeout;
+    timeout.tv_sec  = time_t(seconds);
+    timeout.tv_usec = suseconds_t((seconds - double(timeout.tv_sec)) * 1.0e6);
+    fd_set input;
+    FD_ZERO(&input);
+    FD_SET(STDIN_FILENO, &input);
+    if (select(STDIN_FILENO + 1, &input, NULL, NULL, &timeout) <= 0)
+        return true;
+
+    char key = 0;
+    if (read(STDIN_FILENO, &key, 1) != 1)
+        return true;
+    switch (key)
+    {
+        case 't': sort_key = SORT_TIME;  break;
+        case 'c': sort_key = SORT_CALLS; break;
+        case 'm': sort_key = SORT_MEAN;  break;
+        case 'n': sort_key = SORT_NAME;  break;
+        case 'q': return false;
+    }
+    return true;
+}
+
+// **************************************************************
+int main(int argc, char *argv[])
+{
+    double interval = 1.0;
+    long nb_refreshes = -1;
+    bool batch = false;
+    std::string filename;
+
+    int option;
+    while ((option = getopt(argc, argv, "i:s:n:bh")) != -1)
+    {
+        switch (option)
+        {
+            case 'i':
+                interval = std::max(0.01, atof(optarg));
+                break;
+            case 's':
+                if      (optarg[0] == 'c') sort_key = SORT_CALLS;
+                else if (optarg[0] == 'm') sort_key = SORT_MEAN;
+                else if (optarg[0] == 'n') sort_key = SORT_NAME;
+                else                       sort_key = SORT_TIME;
+                break;
+            case 'n':
+                nb_refreshes = atol(optarg);
+                break;
+            case 'b':
+                batch = true;
+                break;
+            default:
+                printf("Usage: %s [-i seconds] [-s time|calls|mean|name] [-n refreshes] [-b] [pid|file]\n", argv[0]);
+                return (option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (optind < argc)
+    {
+        filename = argv[optind];
+        if (filename.find('/') == std::string::npos)
+            filename = std::string(timing::live_stats_prefix) + filename;
+    }
+    else
+        filename = Find_Live_Stats_File();
+    if (filename.empty())
+    {
+        printf("ERROR: No %s* file found: is the program calling TIMERS_ENABLE_LIVE_STATS()?\n", timing::live_stats_prefix);
+        return EXIT_FAILURE;
+    }
+
+    const int fd = open(filename.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 or fstat(fd, &status) != 0 or size_t(status.st_size) < sizeof(timing::Live_Stats_Header))
+    {
+        printf("ERROR: Could not open file \"%s\"!\n", filename.c_str());
+        return EXIT_FAILURE;
+    }
+    const size_t size = size_t(status.st_size);
+    void *memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        printf("ERROR: Could not map file \"%s\"!\n", filename.c_str());
+        return EXIT_FAILURE;
+    }
+    const timing::Live_Stats_Header *header = static_cast<const timing::Live_Stats_Header *>(memory);
+    if (memcmp(header->magic, timing::live_stats_magic, sizeof(timing::live_stats_magic)) != 0
+        or header->version != timing::live_stats_version)
+    {
+        printf("ERROR: \"%s\" is not a live statistics file of this version of the library!\n", filename.c_str());
+        return EXIT_FAILURE;
+    }
+
+    const bool interactive = (not batch and isatty(STDIN_FILENO));
+    if (interactive)
+    {
+        termios terminal;
+        tcgetattr(STDIN_FILENO, &original_terminal);
+        terminal = original_terminal;
+        terminal.c_lflag &= ~tcflag_t(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &terminal);
+        terminal_changed = true;
+        atexit(Restore_Terminal);
+    }
+
+    Snapshot previous, current;
+    if (not Read_Snapshot(static_cast<const char *>(memory), size, previous))
+    {
+        printf("ERROR: Could not read \"%s\"!\n", filename.c_str());
+        return EXIT_FAILURE;
+    }
+    for (long refresh = 0 ; nb_refreshes < 0 or refresh < nb_refreshes ; refresh++)
+    {
+        if (not Wait_For_Key(interval, interactive))
+            break;
+        if (not Read_Snapshot(static_cast<const char *>(memory), size, current))
+            continue;
+        // Nothing new since the last refresh
+        if (current.header.update_ns == previous.header.update_ns and not current.header.is_finished)
+            continue;
+        Print_Snapshot(filename, previous, current, batch);
+        if (current.header.is_finished)
+            break;
+        previous = current;
+    }
+
+    munmap(memory, size);
+    return EXIT_SUCCESS;
+}
+
+// ********** End of file ***************************************